@@ -0,0 +1,211 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Hardware performance counters of the calling thread, read via
+ * perf_event_open.
+ * Only user space is counted. Counters that cannot be opened, e.g. due
+ * to missing hardware support or permissions, are skipped.
+ */
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+/*----------------------------------------------------------------------------*/
+
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+
+typedef enum {
+
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+
+    PERF_NUM_COUNTERS,
+
+} PerfCounter;
+
+static const char* const PERF_COUNTER_NAMES[PERF_NUM_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "branch_misses",
+    "dtlb_misses",
+};
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    /* -1 if not available */
+    int fds[PERF_NUM_COUNTERS];
+
+} PerfCounters;
+
+/*----------------------------------------------------------------------------*/
+
+#define PERF_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return number of counters opened
+ */
+static inline size_t perf_counters_open(PerfCounters* counters) {
+
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } EVENTS[PERF_NUM_COUNTERS] = {
+        [PERF_CYCLES] =
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        [PERF_INSTRUCTIONS] =
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        [PERF_L1D_MISSES] =
+            {PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+        [PERF_LLC_MISSES] =
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        [PERF_BRANCH_MISSES] =
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        [PERF_DTLB_MISSES] =
+            {PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+    };
+
+    size_t num_opened = 0;
+
+    for(size_t i = 0; i < PERF_NUM_COUNTERS; ++i) {
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+
+        attr.size = sizeof(attr);
+        attr.type = EVENTS[i].type;
+        attr.config = EVENTS[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        if(0 <= counters->fds[i]) {
+            ++num_opened;
+        }
+
+    }
+
+    return num_opened;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void perf_counters_start(PerfCounters* counters) {
+
+    for(size_t i = 0; i < PERF_NUM_COUNTERS; ++i) {
+
+        if(0 > counters->fds[i]) continue;
+
+        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Adds the counts since perf_counters_start to values.
+ * Counts are scaled up if the kernel had to multiplex the counters.
+ */
+static inline void perf_counters_stop(
+        PerfCounters* counters, uint64_t values[PERF_NUM_COUNTERS]) {
+
+    for(size_t i = 0; i < PERF_NUM_COUNTERS; ++i) {
+
+        if(0 > counters->fds[i]) continue;
+
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        /* value, time enabled, time running */
+        uint64_t read_values[3] = {0};
+
+        if(sizeof(read_values) !=
+                read(counters->fds[i], read_values, sizeof(read_values))) {
+            continue;
+        }
+
+        if((0 < read_values[2]) && (read_values[2] < read_values[1])) {
+            read_values[0] =
+                (double) read_values[0] * read_values[1] / read_values[2];
+        }
+
+        values[i] += read_values[0];
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void perf_counters_close(PerfCounters* counters) {
+
+    for(size_t i = 0; i < PERF_NUM_COUNTERS; ++i) {
+
+        if(0 <= counters->fds[i]) {
+            close(counters->fds[i]);
+        }
+
+        counters->fds[i] = -1;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,829 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Benchmarks for all Ringbuffer implementations and the buffercache.
+ * Results are written to stdout as CSV, one line per measurement:
+ *
+ * workload     fill:     add to an empty ringbuffer until it is full
+ *              drain:    pop from a full ringbuffer until it is empty
+ *              mixed:    alternating add / pop on a half-full ringbuffer
+ *              transfer: producer threads add, consumer threads pop
+ *              churn:    get / release Buffer s of varying sizes
+ * pattern      single:   add / pop, batch: add_n / pop_n of BATCH_SIZE
+ * pNN_ns       percentiles of the time per operation, measured over chunks
+ *              of CHUNK_OPS operations.
+ *              For transfer, percentiles of the time elements stayed in the
+ *              ringbuffer, sampled every SAMPLE_INTERVAL elements.
+ *
+ * With -p, hardware performance counters of the single threaded workloads
+ * are appended per operation, see perf_counters.h.
+ * Counters not available on this machine are left empty.
+ * They include reading the clock once per chunk.
+ *
+ * Usage: ringbuffer_bench [-p] [-n number of operations] [-m max capacity]
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/ringbuffer.h"
+#include "../include/ringbuffer_latency.h"
+#include "../include/array_ringbuffer.h"
+#include "../include/caching_ringbuffer.h"
+#include "../include/spsc_ringbuffer.h"
+#include "../include/mpmc_ringbuffer.h"
+#include "../include/buffercache.h"
+#include "../include/buffer_depot.h"
+#include "perf_counters.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CHUNK_OPS 64
+#define BATCH_SIZE 32
+#define SAMPLE_INTERVAL 64
+#define CHURN_BUFFERS 64
+#define MAX_THREADS 4
+
+/* Histograms hold picoseconds to resolve operations below 1 ns */
+#define PSECS_PER_NSEC 1000
+
+/*----------------------------------------------------------------------------*/
+
+static size_t num_ops = 4 * 1024 * 1024;
+static size_t max_capacity = 16 * 1024 * 1024;
+
+static bool profile = false;
+static PerfCounters perf_counters;
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    const char* name;
+    Ringbuffer* (*create)(size_t, void (*)(void*, void*), void*);
+
+    /* Number of threads that might add / pop concurrently */
+    size_t max_producers;
+    size_t max_consumers;
+
+} Implementation;
+
+static const Implementation IMPLEMENTATIONS[] = {
+    {"ringbuffer", ringbuffer_create, 1, 0},
+    {"array_ringbuffer", array_ringbuffer_create, 1, 0},
+    {"caching_ringbuffer", caching_ringbuffer_create, 1, 0},
+    {"spsc_ringbuffer", spsc_ringbuffer_create, 1, 1},
+    {"mpmc_ringbuffer", mpmc_ringbuffer_create, MAX_THREADS, MAX_THREADS},
+};
+
+#define NUM_IMPLEMENTATIONS \
+    (sizeof(IMPLEMENTATIONS) / sizeof(IMPLEMENTATIONS[0]))
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    RingbufferLatency histogram;
+    size_t num_ops;
+    uint64_t nsecs;
+
+    bool profiled;
+    uint64_t counters[PERF_NUM_COUNTERS];
+
+} Measurement;
+
+/*----------------------------------------------------------------------------*/
+
+static uint64_t now_nsecs(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void record_sample(Measurement* measurement, uint64_t psecs) {
+
+    ++measurement->histogram.counts[ringbuffer_latency_bucket(psecs)];
+    ++measurement->histogram.num_samples;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void record_chunk(
+        Measurement* measurement, uint64_t start, size_t num_ops) {
+
+    uint64_t nsecs = now_nsecs() - start;
+
+    measurement->nsecs += nsecs;
+    measurement->num_ops += num_ops;
+
+    record_sample(measurement, nsecs * PSECS_PER_NSEC / num_ops);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void profile_start(void) {
+
+    if(profile) {
+        perf_counters_start(&perf_counters);
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void profile_stop(Measurement* measurement) {
+
+    if(profile) {
+        perf_counters_stop(&perf_counters, measurement->counters);
+        measurement->profiled = true;
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void print_header(void) {
+
+    fprintf(stdout, "workload,implementation,capacity,pattern,"
+            "producers,consumers,ops,seconds,ops_per_sec,"
+            "p50_ns,p99_ns,p999_ns");
+
+    for(size_t i = 0; profile && (i < PERF_NUM_COUNTERS); ++i) {
+        fprintf(stdout, ",%s_per_op", PERF_COUNTER_NAMES[i]);
+    }
+
+    fprintf(stdout, "\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void print_measurement(
+        const char* workload,
+        const char* implementation,
+        size_t capacity,
+        const char* pattern,
+        size_t num_producers,
+        size_t num_consumers,
+        Measurement* measurement) {
+
+    double seconds = 1e-9 * measurement->nsecs;
+    RingbufferLatency* histogram = &measurement->histogram;
+
+    fprintf(stdout, "%s,%s,%zu,%s,%zu,%zu,%zu,%.6f,%.0f,%.3f,%.3f,%.3f",
+            workload, implementation, capacity, pattern,
+            num_producers, num_consumers,
+            measurement->num_ops, seconds,
+            (0 < seconds) ? measurement->num_ops / seconds : 0,
+            (double) ringbuffer_latency_percentile(histogram, 50)
+            / PSECS_PER_NSEC,
+            (double) ringbuffer_latency_percentile(histogram, 99)
+            / PSECS_PER_NSEC,
+            (double) ringbuffer_latency_percentile(histogram, 99.9)
+            / PSECS_PER_NSEC);
+
+    for(size_t i = 0; profile && (i < PERF_NUM_COUNTERS); ++i) {
+
+        if(measurement->profiled && (0 <= perf_counters.fds[i])) {
+            fprintf(stdout, ",%.3f",
+                    (double) measurement->counters[i] / measurement->num_ops);
+        } else {
+            fprintf(stdout, ",");
+        }
+
+    }
+
+    fprintf(stdout, "\n");
+    fflush(stdout);
+
+}
+
+/******************************************************************************
+                           SINGLE THREADED WORKLOADS
+ ******************************************************************************/
+
+static void* items[BATCH_SIZE];
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Adds num items, either one by one or in batches.
+ * @return number of items added
+ */
+static size_t add_items(Ringbuffer* ring, size_t num, bool batch) {
+
+    size_t num_added = 0;
+
+    if(! batch) {
+
+        for(size_t i = 0; i < num; ++i) {
+            num_added += ring->add(ring, items[i % BATCH_SIZE]);
+        }
+
+        return num_added;
+
+    }
+
+    while(num_added < num) {
+
+        size_t n = num - num_added;
+        n = (BATCH_SIZE < n) ? BATCH_SIZE : n;
+
+        size_t added = ring->add_n(ring, items, n);
+
+        if(0 == added) {
+            break;
+        }
+
+        num_added += added;
+
+    }
+
+    return num_added;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Pops num items, either one by one or in batches.
+ * @return number of items popped
+ */
+static size_t pop_items(Ringbuffer* ring, size_t num, bool batch) {
+
+    void* out[BATCH_SIZE];
+    size_t num_popped = 0;
+
+    if(! batch) {
+
+        for(size_t i = 0; i < num; ++i) {
+            num_popped += (0 != ring->pop(ring));
+        }
+
+        return num_popped;
+
+    }
+
+    while(num_popped < num) {
+
+        size_t n = num - num_popped;
+        n = (BATCH_SIZE < n) ? BATCH_SIZE : n;
+
+        size_t popped = ring->pop_n(ring, out, n);
+
+        if(0 == popped) {
+            break;
+        }
+
+        num_popped += popped;
+
+    }
+
+    return num_popped;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool run_single_threaded(
+        const Implementation* implementation, size_t capacity, bool batch) {
+
+    Ringbuffer* ring = implementation->create(capacity, 0, 0);
+
+    if(0 == ring) goto error;
+
+    Measurement fill = {0};
+    Measurement drain = {0};
+    Measurement mixed = {0};
+
+    size_t num_rounds = num_ops / capacity;
+    num_rounds = (0 == num_rounds) ? 1 : num_rounds;
+
+    for(size_t round = 0; round < num_rounds; ++round) {
+
+        profile_start();
+
+        for(size_t done = 0; done < capacity;) {
+
+            size_t chunk = capacity - done;
+            chunk = (CHUNK_OPS < chunk) ? CHUNK_OPS : chunk;
+
+            uint64_t start = now_nsecs();
+
+            if(chunk != add_items(ring, chunk, batch)) goto error;
+
+            record_chunk(&fill, start, chunk);
+            done += chunk;
+
+        }
+
+        profile_stop(&fill);
+        profile_start();
+
+        for(size_t done = 0; done < capacity;) {
+
+            size_t chunk = capacity - done;
+            chunk = (CHUNK_OPS < chunk) ? CHUNK_OPS : chunk;
+
+            uint64_t start = now_nsecs();
+
+            if(chunk != pop_items(ring, chunk, batch)) goto error;
+
+            record_chunk(&drain, start, chunk);
+            done += chunk;
+
+        }
+
+        profile_stop(&drain);
+
+    }
+
+    /* Half-full, each chunk adds and pops the same number of items */
+    size_t half = (capacity + 1) / 2;
+    size_t chunk = (CHUNK_OPS / 2 < half) ? CHUNK_OPS / 2 : half;
+
+    if(half != add_items(ring, half, batch)) goto error;
+
+    profile_start();
+
+    for(size_t done = 0; done < num_ops; done += 2 * chunk) {
+
+        uint64_t start = now_nsecs();
+
+        if(chunk != add_items(ring, chunk, batch)) goto error;
+        if(chunk != pop_items(ring, chunk, batch)) goto error;
+
+        record_chunk(&mixed, start, 2 * chunk);
+
+    }
+
+    profile_stop(&mixed);
+
+    ring = ring->free(ring);
+
+    const char* pattern = batch ? "batch" : "single";
+
+    print_measurement("fill", implementation->name, capacity, pattern,
+            1, 1, &fill);
+    print_measurement("drain", implementation->name, capacity, pattern,
+            1, 1, &drain);
+    print_measurement("mixed", implementation->name, capacity, pattern,
+            1, 1, &mixed);
+
+    return true;
+
+error:
+
+    if(0 != ring) {
+        ring->free(ring);
+    }
+
+    fprintf(stderr, "%s with capacity %zu failed\n",
+            implementation->name, capacity);
+
+    return false;
+
+}
+
+/******************************************************************************
+                            MULTI THREADED WORKLOADS
+ ******************************************************************************/
+
+/**
+ * Items are either 2 or carry the time they were added, shifted left by
+ * one, with the lowest bit set.
+ */
+typedef struct {
+
+    Ringbuffer* ring;
+    size_t num_items;
+    atomic_size_t* num_items_left;
+    Measurement latency;
+
+} Worker;
+
+/*----------------------------------------------------------------------------*/
+
+static void* producer(void* arg) {
+
+    Worker* worker = arg;
+    Ringbuffer* ring = worker->ring;
+
+    for(size_t i = 0; i < worker->num_items; ++i) {
+
+        uintptr_t item = 2;
+
+        if(0 == i % SAMPLE_INTERVAL) {
+            item = (now_nsecs() << 1) | 1;
+        }
+
+        while(! ring->add(ring, (void*) item)) {
+            sched_yield();
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* consumer(void* arg) {
+
+    Worker* worker = arg;
+    Ringbuffer* ring = worker->ring;
+
+    while(0 < atomic_load_explicit(
+                worker->num_items_left, memory_order_relaxed)) {
+
+        uintptr_t item = (uintptr_t) ring->pop(ring);
+
+        if(0 == item) {
+            sched_yield();
+            continue;
+        }
+
+        atomic_fetch_sub_explicit(
+                worker->num_items_left, 1, memory_order_relaxed);
+
+        if(1 & item) {
+            record_sample(&worker->latency,
+                    (now_nsecs() - (item >> 1)) * PSECS_PER_NSEC);
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool run_transfer(
+        const Implementation* implementation,
+        size_t capacity,
+        size_t num_producers,
+        size_t num_consumers) {
+
+    Ringbuffer* ring = implementation->create(capacity, 0, 0);
+
+    if(0 == ring) goto error;
+
+    size_t items_per_producer = num_ops / num_producers;
+    atomic_size_t num_items_left = items_per_producer * num_producers;
+
+    pthread_t threads[2 * MAX_THREADS];
+    Worker workers[2 * MAX_THREADS];
+
+    memset(workers, 0, sizeof(workers));
+
+    uint64_t start = now_nsecs();
+
+    for(size_t i = 0; i < num_producers + num_consumers; ++i) {
+
+        bool is_producer = i < num_producers;
+
+        workers[i].ring = ring;
+        workers[i].num_items = items_per_producer;
+        workers[i].num_items_left = &num_items_left;
+
+        if(0 != pthread_create(threads + i, 0,
+                    is_producer ? producer : consumer, workers + i)) {
+            goto error;
+        }
+
+    }
+
+    Measurement transfer = {0};
+
+    for(size_t i = 0; i < num_producers + num_consumers; ++i) {
+
+        pthread_join(threads[i], 0);
+
+        RingbufferLatency* latency = &workers[i].latency.histogram;
+
+        for(size_t b = 0; b < RINGBUFFER_LATENCY_BUCKETS; ++b) {
+            transfer.histogram.counts[b] += latency->counts[b];
+        }
+
+        transfer.histogram.num_samples += latency->num_samples;
+
+    }
+
+    transfer.nsecs = now_nsecs() - start;
+    transfer.num_ops = items_per_producer * num_producers;
+
+    ring = ring->free(ring);
+
+    print_measurement("transfer", implementation->name, capacity, "single",
+            num_producers, num_consumers, &transfer);
+
+    return true;
+
+error:
+
+    fprintf(stderr, "%s with capacity %zu failed\n",
+            implementation->name, capacity);
+
+    return false;
+
+}
+
+/******************************************************************************
+                                BUFFER CHURN
+ ******************************************************************************/
+
+static const size_t CHURN_SIZES[] = {64, 256, 1024, 4096, 512, 128};
+
+#define NUM_CHURN_SIZES (sizeof(CHURN_SIZES) / sizeof(CHURN_SIZES[0]))
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* malloc_buffer(size_t size) {
+
+    Buffer* buffer = malloc(sizeof(Buffer));
+
+    if(0 == buffer) goto error;
+
+    buffer->data = malloc(size);
+
+    if(0 == buffer->data) {
+        free(buffer);
+        goto error;
+    }
+
+    buffer->capacity_bytes = size;
+    buffer->bytes_used = 0;
+
+    return buffer;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void free_buffer(Buffer* buffer) {
+
+    free(buffer->data);
+    free(buffer);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void release_churn_buffers(Buffer** buffers, Ringbuffer* cache) {
+
+    for(size_t i = 0; i < CHURN_BUFFERS; ++i) {
+
+        if(0 == buffers[i]) {
+            continue;
+        }
+
+        if(0 == cache) {
+            free_buffer(buffers[i]);
+        } else {
+            buffercache_release_buffer(cache, buffers[i]);
+        }
+
+        buffers[i] = 0;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Keeps CHURN_BUFFERS Buffer s, replaces one of them per operation by
+ * a Buffer of a different size.
+ * @param cache 0 to use malloc / free
+ */
+static bool run_churn(const char* name, Ringbuffer* cache) {
+
+    Buffer* buffers[CHURN_BUFFERS] = {0};
+    Measurement churn = {0};
+
+    for(size_t i = 0; i < CHURN_BUFFERS; ++i) {
+        buffers[i] = (0 == cache) ? malloc_buffer(CHURN_SIZES[0])
+            : buffercache_get_buffer(cache, CHURN_SIZES[0]);
+
+        if(0 == buffers[i]) goto error;
+
+    }
+
+    uint32_t random = 1;
+
+    profile_start();
+
+    for(size_t done = 0; done < num_ops; done += CHUNK_OPS) {
+
+        uint64_t start = now_nsecs();
+
+        for(size_t i = 0; i < CHUNK_OPS; ++i) {
+
+            random = random * 1103515245 + 12345;
+
+            size_t index = (random >> 16) % CHURN_BUFFERS;
+            size_t size = CHURN_SIZES[(done + i) % NUM_CHURN_SIZES];
+
+            if(0 == cache) {
+                free_buffer(buffers[index]);
+                buffers[index] = malloc_buffer(size);
+            } else {
+                buffercache_release_buffer(cache, buffers[index]);
+                buffers[index] = buffercache_get_buffer(cache, size);
+            }
+
+            if(0 == buffers[index]) goto error;
+
+            buffers[index]->data[0] = 1;
+
+        }
+
+        record_chunk(&churn, start, CHUNK_OPS);
+
+    }
+
+    profile_stop(&churn);
+
+    release_churn_buffers(buffers, cache);
+
+    print_measurement("churn", name, CHURN_BUFFERS, "single", 1, 1, &churn);
+
+    return true;
+
+error:
+
+    release_churn_buffers(buffers, cache);
+
+    fprintf(stderr, "%s with capacity %zu failed\n",
+            name, (size_t) CHURN_BUFFERS);
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    int option = 0;
+
+    while(-1 != (option = getopt(argc, argv, "pn:m:"))) {
+
+        switch(option) {
+
+            case 'p':
+                profile = true;
+                break;
+
+            case 'n':
+                num_ops = strtoull(optarg, 0, 10);
+                break;
+
+            case 'm':
+                max_capacity = strtoull(optarg, 0, 10);
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-p] [-n number of operations] "
+                        "[-m max capacity]\n", argv[0]);
+                return EXIT_FAILURE;
+
+        }
+
+    }
+
+    if(0 == num_ops) {
+        num_ops = 1;
+    }
+
+    for(size_t i = 0; i < BATCH_SIZE; ++i) {
+        items[i] = (void*) (uintptr_t) (i + 1);
+    }
+
+    if(profile && (0 == perf_counters_open(&perf_counters))) {
+        fprintf(stderr, "No performance counters available\n");
+    }
+
+    print_header();
+
+    bool ok = true;
+
+    for(size_t capacity = 8; capacity <= max_capacity; capacity *= 8) {
+
+        for(size_t i = 0; i < NUM_IMPLEMENTATIONS; ++i) {
+
+            const Implementation* implementation = IMPLEMENTATIONS + i;
+
+            ok &= run_single_threaded(implementation, capacity, false);
+            ok &= run_single_threaded(implementation, capacity, true);
+
+            if(0 == implementation->max_consumers) {
+                continue;
+            }
+
+            for(size_t producers = 1;
+                    producers <= implementation->max_producers;
+                    producers *= 2) {
+
+                size_t consumers =
+                    (producers < implementation->max_consumers) ?
+                    producers : implementation->max_consumers;
+
+                ok &= run_transfer(
+                        implementation, capacity, producers, consumers);
+
+            }
+
+        }
+
+    }
+
+    Ringbuffer* cache = buffercache_create(CHURN_BUFFERS);
+
+    ok &= run_churn("buffercache", cache);
+    ok &= run_churn("malloc", 0);
+
+    cache = cache->free(cache);
+
+    cache = buffercache_create_with_classes(
+            64, 4096, CHURN_BUFFERS);
+
+    ok &= run_churn("buffercache_classes", cache);
+
+    cache = cache->free(cache);
+
+    cache = buffercache_create_with_slabs(4096, CHURN_BUFFERS);
+
+    ok &= run_churn("buffercache_slabs", cache);
+
+    cache = cache->free(cache);
+
+    BufferDepot* depot = buffer_depot_create(CHURN_BUFFERS / 4, 4);
+    cache = depot->create_cache(depot);
+
+    ok &= run_churn("buffer_depot", cache);
+
+    cache = cache->free(cache);
+    depot = depot->free(depot);
+
+    if(profile) {
+        perf_counters_close(&perf_counters);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,78 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __ARRAY_RINGBUFFER_H__
+#define __ARRAY_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new Ringbuffer that keeps its entries in one contiguous array.
+ * Offers the same interface and overwrite semantics as a Ringbuffer created by
+ * ringbuffer_create, but its entries are stored inline, directly behind the
+ * ringbuffer itself, thus it requires a single allocation and avoids chasing
+ * pointers from entry to entry.
+ * The first resize moves the entries into a separately allocated array.
+ * If capacity is a power of two, indices are wrapped by masking.
+ * @param capacity number of elements this ringbuffer can hold before overwriting elements.
+ * @param free_item function to free elements. If 0, elements that are overwritten wont be freed.
+ * @param free_item_additional_arg arbitrary pointer handed over to free_item
+ * @see ringbuffer_create
+ */
+Ringbuffer* array_ringbuffer_create(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new array-backed Ringbuffer with a specific policy for adding to a
+ * full ringbuffer.
+ * Since this ringbuffer is not thread-safe, RINGBUFFER_BLOCK is not supported.
+ * @param policy either RINGBUFFER_OVERWRITE or RINGBUFFER_REJECT
+ * @return the new ringbuffer or 0 in case of error or unsupported policy
+ * @see array_ringbuffer_create
+ */
+Ringbuffer* array_ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
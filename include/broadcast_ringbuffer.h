@@ -0,0 +1,126 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides a ringbuffer that hands every element to several
+ * readers. See the BroadcastRingbuffer struct.
+ */
+#ifndef __BROADCAST_RINGBUFFER_H__
+#define __BROADCAST_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A broadcast ringbuffer is a first-in first-out queue with a fixed capacity
+ * that is read by a fixed number of readers.
+ * Every element is added once and is seen by every reader.
+ * Each reader has its own position within the ringbuffer, identified by
+ * a reader index in [0, num_readers).
+ * One thread might add elements while each reader is served by
+ * its own thread, without any further synchronization.
+ */
+typedef struct BroadcastRingbuffer {
+
+    /**
+     * Get the number of elements this ringbuffer might hold.
+     */
+    size_t        (*capacity)    (struct BroadcastRingbuffer* self);
+
+    /**
+     * Get the number of readers of this ringbuffer.
+     */
+    size_t        (*num_readers) (struct BroadcastRingbuffer* self);
+
+    /**
+     * Add an element for all readers to see.
+     * What happens if the slowest reader still has not released the
+     * oldest element depends on the policy.
+     * 0 cannot be added.
+     * @return true on success, false in case of failure
+     */
+    bool          (*add)         (struct BroadcastRingbuffer* self, void* item);
+
+    /**
+     * Get the oldest element reader has not released yet.
+     * @return the element or 0 if there is no such element
+     */
+    void*         (*peek)        (struct BroadcastRingbuffer* self,
+                                  size_t reader);
+
+    /**
+     * Done with the element returned by peek, move on to the next one.
+     * @return true on success, false if there was nothing to release
+     */
+    bool          (*release)     (struct BroadcastRingbuffer* self,
+                                  size_t reader);
+
+    /**
+     * Free this ringbuffer and all elements contained within.
+     * @return 0 on success or self in case of error.
+     */
+    struct BroadcastRingbuffer* (*free) (struct BroadcastRingbuffer* self);
+
+} BroadcastRingbuffer;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new BroadcastRingbuffer.
+ * The policy decides what add does if the slowest reader lags capacity
+ * elements behind:
+ * RINGBUFFER_REJECT and RINGBUFFER_BLOCK fail or wait, respectively.
+ * Only with RINGBUFFER_BLOCK, release checks for a waiting producer.
+ * Elements are handed to free_item once every reader released them and their
+ * slot is reused.
+ * RINGBUFFER_OVERWRITE never waits for readers. A reader that lags behind
+ * loses the overwritten elements and continues with the oldest element
+ * still available. Since a reader might still use an element when it is
+ * overwritten, free_item must be 0 with RINGBUFFER_OVERWRITE.
+ * @param capacity minimum number of elements this ringbuffer can hold.
+ *        Is rounded up to the next power of two, check with capacity().
+ * @param num_readers number of readers
+ * @return the new ringbuffer or 0 in case of error
+ */
+BroadcastRingbuffer* broadcast_ringbuffer_create(
+        size_t capacity,
+        size_t num_readers,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides logical buffers made up of a chain of Buffer s.
+ * See the BufferChain struct.
+ */
+#ifndef __BUFFER_CHAIN_H__
+#define __BUFFER_CHAIN_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+#include "buffercache.h"
+#include <sys/uio.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A chain behaves like one buffer of arbitrary length, but keeps its data
+ * in segments - Buffer s of segment_size bytes got from a cache and linked
+ * via Buffer.next.
+ * Appending beyond the last segment adds another one, thus data is never
+ * reallocated or copied, and the cache only ever deals with Buffer s of
+ * the same size.
+ *
+ * Not thread-safe.
+ */
+typedef struct BufferChain {
+
+    /**
+     * Append num_bytes bytes from data, getting new segments as required.
+     * @return number of bytes appended, less than num_bytes only if no
+     *         more segments could be got
+     */
+    size_t        (*append)   (struct BufferChain* self,
+                               const void* data, size_t num_bytes);
+
+    /**
+     * @return number of bytes in the chain
+     */
+    size_t        (*length)   (struct BufferChain* self);
+
+    /**
+     * Describe the data of the first max_iov segments, e.g. for writev.
+     * The iovecs are valid until the chain is changed.
+     * @return number of iovecs filled
+     */
+    size_t        (*iovec)    (struct BufferChain* self,
+                               struct iovec* iov, size_t max_iov);
+
+    /**
+     * Release all segments to the cache at once, leaving the chain empty.
+     * The chain might be appended to again afterwards.
+     */
+    void          (*release)  (struct BufferChain* self);
+
+    /**
+     * Release all segments and free the chain itself.
+     * The cache is not freed.
+     * @return 0 on success or self in case of error.
+     */
+    struct BufferChain* (*free) (struct BufferChain* self);
+
+} BufferChain;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new, empty BufferChain.
+ * @param cache buffercache to get segments from and release them to.
+ *        If 0, segments are allocated and freed.
+ * @param segment_size number of bytes per segment
+ * @return the new chain or 0 in case of error
+ */
+BufferChain* buffer_chain_create(Ringbuffer* cache, size_t segment_size);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
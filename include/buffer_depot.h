@@ -0,0 +1,99 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides sharing Buffer s among threads in magazines.
+ * See the BufferDepot struct.
+ */
+#ifndef __BUFFER_DEPOT_H__
+#define __BUFFER_DEPOT_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+#include "buffercache.h"
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A depot keeps Buffer s in magazines - stacks of up to magazine_size
+ * Buffer s - and hands them to per-thread caches in exchange for other
+ * magazines, following the magazine layer of Bonwick's slab allocator.
+ *
+ * Each thread creates its own cache, which holds two magazines.
+ * Getting and releasing Buffer s only touches these magazines, without any
+ * atomic operation. Only if both of them are empty on get, or full on
+ * release, the cache swaps one of them with the depot under a lock.
+ *
+ * The depot holds at most max_magazines magazines, if they are all full,
+ * released Buffer s are freed.
+ * Owned Buffer s are handed back to their owner instead, thus Buffer s of
+ * a cache without inbox must only be released to caches of the thread
+ * owning it, see buffercache_free_buffers.
+ * Thus there are never more than
+ * (2 * number of caches + max_magazines) * magazine_size Buffer s cached.
+ *
+ * create_cache might be called by any thread at any time.
+ */
+typedef struct BufferDepot {
+
+    /**
+     * Create a cache to be used by the calling thread only.
+     * The cache is a Ringbuffer to be handed to buffercache_get_buffer and
+     * buffercache_release_buffer.
+     * Freeing the cache returns its Buffer s to the depot.
+     * @return the new cache or 0 in case of error
+     */
+    Ringbuffer*   (*create_cache) (struct BufferDepot* self);
+
+    /**
+     * Free all Buffer s in the depot and the depot itself.
+     * All caches must have been freed before.
+     * @return 0 on success or self in case of error.
+     */
+    struct BufferDepot* (*free)   (struct BufferDepot* self);
+
+} BufferDepot;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new BufferDepot.
+ * @param magazine_size number of Buffer s in one magazine
+ * @param max_magazines number of magazines the depot holds at most
+ * @return the new depot or 0 in case of error
+ */
+BufferDepot* buffer_depot_create(size_t magazine_size, size_t max_magazines);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides writing Buffer s popped from a ringbuffer to a
+ * file descriptor. See the BufferDrain struct.
+ */
+#ifndef __BUFFER_DRAIN_H__
+#define __BUFFER_DRAIN_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+#include "buffercache.h"
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A drain pops Buffer s from a ringbuffer and writes their used bytes
+ * to a file descriptor with a single writev per call.
+ * Buffer s that have been written completely are released to the cache.
+ * The remainder of a partial write is kept and written first by the next
+ * call, thus the byte stream remains intact even on non-blocking
+ * descriptors.
+ *
+ * Not thread-safe, but the ringbuffer might be filled concurrently if it
+ * is thread-safe itself.
+ */
+typedef struct BufferDrain {
+
+    /**
+     * Write the remainder of the previous call and as many Buffer s from
+     * the ringbuffer as fit into max_buffers to fd.
+     * @return number of bytes written, 0 if there was nothing to write,
+     *         -1 in case of failure with errno set by writev.
+     *         Nothing is lost on failure, e.g. on EAGAIN.
+     */
+    ssize_t       (*drain)    (struct BufferDrain* self, int fd);
+
+    /**
+     * @return number of bytes popped but not written yet
+     */
+    size_t        (*pending)  (struct BufferDrain* self);
+
+    /**
+     * Release all pending Buffer s to the cache, their remaining bytes
+     * are discarded, and free the drain itself.
+     * The ringbuffer and the cache are not freed.
+     * @return 0 on success or self in case of error.
+     */
+    struct BufferDrain* (*free) (struct BufferDrain* self);
+
+} BufferDrain;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new BufferDrain.
+ * @param ring ringbuffer to pop Buffer s from
+ * @param cache buffercache to release written Buffer s to. If 0, they are
+ *        freed.
+ * @param max_buffers maximum number of Buffer s written at once, at most
+ *        IOV_MAX
+ * @return the new drain or 0 in case of error
+ */
+BufferDrain* buffer_drain_create(
+        Ringbuffer* ring, Ringbuffer* cache, size_t max_buffers);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides reading from a file descriptor into Buffer s that are
+ * added to a ringbuffer. See the BufferIngest struct.
+ */
+#ifndef __BUFFER_INGEST_H__
+#define __BUFFER_INGEST_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+#include "buffercache.h"
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * An ingest takes up to max_buffers Buffer s from a buffercache, fills them
+ * with a single system call and adds the filled ones to a ringbuffer
+ * with a single add_n.
+ * Buffer s that did not receive any data go back to the cache right away.
+ *
+ * If the ringbuffer does not accept all filled Buffer s, the remaining
+ * ones are kept and added first by the next call, which does not read
+ * until all of them have been added.
+ *
+ * Not thread-safe, but the ringbuffer might be drained concurrently if it
+ * is thread-safe itself.
+ */
+typedef struct BufferIngest {
+
+    /**
+     * Read a byte stream from fd with readv.
+     * All but the last filled Buffer are filled completely.
+     * @return number of bytes read, 0 on end of file, -1 in case of
+     *         failure with errno set by readv, or ENOBUFS if Buffer s of
+     *         the previous call could still not be added.
+     */
+    ssize_t       (*read)     (struct BufferIngest* self, int fd);
+
+    /**
+     * Receive datagrams from the socket fd with recvmmsg, one per Buffer.
+     * Blocks until the first datagram arrives unless fd is non-blocking,
+     * but not for the others.
+     * Datagrams longer than buffer_size are truncated.
+     * @return number of datagrams received, -1 in case of failure with
+     *         errno set by recvmmsg, or ENOBUFS if Buffer s of the previous
+     *         call could still not be added.
+     */
+    ssize_t       (*receive)  (struct BufferIngest* self, int fd);
+
+    /**
+     * @return number of filled Buffer s not added to the ringbuffer yet
+     */
+    size_t        (*pending)  (struct BufferIngest* self);
+
+    /**
+     * Release all pending Buffer s to the cache, their data is discarded,
+     * and free the ingest itself.
+     * The ringbuffer and the cache are not freed.
+     * @return 0 on success or self in case of error.
+     */
+    struct BufferIngest* (*free) (struct BufferIngest* self);
+
+} BufferIngest;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new BufferIngest.
+ * @param cache buffercache to take Buffer s from. If 0, Buffer s are
+ *        allocated and freed instead.
+ * @param ring ringbuffer to add filled Buffer s to
+ * @param max_buffers maximum number of Buffer s filled at once, at most
+ *        IOV_MAX
+ * @param buffer_size number of bytes per Buffer
+ * @return the new ingest or 0 in case of error
+ */
+BufferIngest* buffer_ingest_create(
+        Ringbuffer* cache,
+        Ringbuffer* ring,
+        size_t max_buffers,
+        size_t buffer_size);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
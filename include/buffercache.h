@@ -38,6 +38,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <stdatomic.h>
+#include "reclaimer.h"
 
 /*----------------------------------------------------------------------------*/
 
@@ -45,12 +47,30 @@
 /**
  * A data buffer to hold arbitrary data
  */
-typedef struct {
+typedef struct Buffer {
 
     size_t capacity_bytes;
     size_t bytes_used;
     uint8_t* data;
 
+    /**
+     * Used to link Buffer s, e.g. the segments of a BufferChain or those
+     * released remotely to a cache
+     */
+    struct Buffer* next;
+
+    /**
+     * Number of references, see buffercache_retain_buffer.
+     * 0 counts as a single reference.
+     */
+    atomic_size_t refs;
+
+    /**
+     * Cache this Buffer has to be released to, 0 if any cache will do.
+     * Set by caches that hand out Buffer s they own, e.g. slabs.
+     */
+    struct Ringbuffer* owner;
+
 } Buffer;
 
 /*----------------------------------------------------------------------------*/
@@ -63,12 +83,125 @@ Ringbuffer* buffercache_create(size_t capacity);
 
 /*----------------------------------------------------------------------------*/
 
+/**
+ * Create a new cache for Buffer s that does not free overwritten Buffer s
+ * itself, but hands them to reclaimer.
+ * The reclaimer should use buffercache_free_buffers.
+ * @see buffercache_create
+ */
+Ringbuffer* buffercache_create_with_reclaimer(
+        size_t capacity, Reclaimer* reclaimer);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new cache for Buffer s that keeps one ringbuffer per size class.
+ * Classes are the powers of two from min_size_bytes up to max_size_bytes.
+ * buffercache_get_buffer serves requests from the smallest class that fits,
+ * buffercache_release_buffer puts Buffer s back into the largest class
+ * they fit.
+ * Buffer s that do not fit any class are neither cached nor kept.
+ * The cache as a Ringbuffer pops from the smallest non-empty class.
+ * @param capacity_per_class number of Buffer s each class can hold before
+ *        overwriting them.
+ */
+Ringbuffer* buffercache_create_with_classes(
+        size_t min_size_bytes,
+        size_t max_size_bytes,
+        size_t capacity_per_class);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new cache that carves Buffer s out of large slabs it owns.
+ * Header and payload of each Buffer share one cache-line aligned block,
+ * thus getting a Buffer requires no allocation unless a new slab is needed.
+ * Requests larger than buffer_size_bytes are served from the heap and
+ * freed on release, as are all other Buffer s not carved by this cache.
+ * Buffer s carved by this cache always return to it on release, and
+ * are all invalidated when the cache is freed.
+ * The cache grows by one slab at a time, its capacity always suffices to
+ * hold all Buffer s carved so far and cannot be resized.
+ * @param num_buffers_per_slab number of Buffer s carved from one slab.
+ */
+Ringbuffer* buffercache_create_with_slabs(
+        size_t buffer_size_bytes, size_t num_buffers_per_slab);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Wrap cache to allow other threads to release Buffer s into it via
+ * buffercache_release_buffer_remote.
+ * Remotely released Buffer s are pushed onto a lock-free inbox, the thread
+ * owning the cache moves them into cache in bulk on its next get.
+ * All other functions must only be called by the owning thread.
+ * Freeing the returned cache frees cache as well.
+ * @return the wrapping cache or 0 in case of error
+ */
+Ringbuffer* buffercache_create_with_inbox(Ringbuffer* cache);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Release a Buffer to a cache owned by another thread.
+ * Thread-safe, might be called by any number of threads at once.
+ * Only the last reference released goes to the inbox.
+ * An owned Buffer goes to the inbox of its owner, regardless of cache.
+ * @param cache a cache created by buffercache_create_with_inbox
+ * @return false if the target cache has no inbox, the Buffer is not
+ *         released then
+ */
+bool buffercache_release_buffer_remote(Ringbuffer* cache, Buffer* buffer);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Frees n Buffer s. To be used as free_items of a Reclaimer.
+ * A Buffer that is still referenced elsewhere only loses one reference.
+ * Owned Buffer s are handed back to their owner instead of being freed.
+ * If the owner has an inbox, see buffercache_create_with_inbox, they go
+ * there and any thread might free them.
+ * Otherwise, e.g. for a bare cache created by buffercache_create_with_slabs,
+ * owned Buffer s must be freed on the thread owning their cache.
+ */
+void buffercache_free_buffers(void** buffers, size_t n, void* additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Get a Buffer holding a single reference.
+ */
 Buffer* buffercache_get_buffer(Ringbuffer* cache, size_t min_size_bytes);
 
 /*----------------------------------------------------------------------------*/
 
+/**
+ * Add a reference to buffer, e.g. to hand it to several consumers without
+ * copying. Each reference has to be released on its own.
+ * Thread-safe, but must only be called while holding a reference.
+ * @return buffer
+ */
+Buffer* buffercache_retain_buffer(Buffer* buffer);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Release a reference to buffer. Only the last reference released puts
+ * buffer back into cache.
+ * An owned Buffer goes back to its owner instead, cache is ignored then.
+ * @return false if buffer could not be put into cache
+ */
 bool buffercache_release_buffer(Ringbuffer* cache, Buffer* buffer);
 
 /*----------------------------------------------------------------------------*/
 
+/**
+ * Release a reference to buffer like buffercache_release_buffer, but free
+ * buffer if it could not be put into cache.
+ * @see buffercache_free_buffers
+ */
+void buffercache_release_or_free_buffer(Ringbuffer* cache, Buffer* buffer);
+
+/*----------------------------------------------------------------------------*/
+
 #endif
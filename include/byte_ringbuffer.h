@@ -0,0 +1,120 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides a ringbuffer for variable-length records.
+ * See the ByteRingbuffer struct.
+ */
+#ifndef __BYTE_RINGBUFFER_H__
+#define __BYTE_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A byte ringbuffer is a first-in first-out queue of variable-length records
+ * that are stored directly within the ringbuffer memory.
+ * The producer reserves memory for a record, writes the record in place
+ * and commits it afterwards.
+ * The consumer peeks at the oldest record, processes it in place and
+ * releases it afterwards.
+ * One thread might produce while another thread consumes concurrently
+ * without any further synchronization.
+ * Records are never overwritten: If there is not enough space, reserve fails.
+ */
+typedef struct ByteRingbuffer {
+
+    /**
+     * Get the number of bytes this ringbuffer holds, including the
+     * per-record overhead.
+     */
+    size_t        (*capacity) (struct ByteRingbuffer* self);
+
+    /**
+     * Reserve memory for a record of length bytes.
+     * Only one reservation might be pending, reserving again discards
+     * a pending reservation.
+     * @param length at most capacity() / 2 - sizeof(size_t)
+     * @return pointer to length contiguous bytes or 0 if there is not
+     * enough space or length is too large.
+     */
+    uint8_t*      (*reserve)  (struct ByteRingbuffer* self, size_t length);
+
+    /**
+     * Make the pending reservation available to the consumer.
+     * @param length actual length of the record, might be less than reserved.
+     * @return true on success, false if there is no reservation or length
+     * exceeds the reservation.
+     */
+    bool          (*commit)   (struct ByteRingbuffer* self, size_t length);
+
+    /**
+     * Get the oldest record without removing it.
+     * @param length receives the length of the record
+     * @return pointer to the record or 0 if the ringbuffer is empty.
+     */
+    uint8_t*      (*peek)     (struct ByteRingbuffer* self, size_t* length);
+
+    /**
+     * Remove the oldest record.
+     * Pointers returned by peek become invalid.
+     * @return true on success, false if the ringbuffer is empty.
+     */
+    bool          (*release)  (struct ByteRingbuffer* self);
+
+    /**
+     * Free this ringbuffer and all records contained within.
+     * @return 0 on success or self in case of error.
+     */
+    struct ByteRingbuffer* (*free) (struct ByteRingbuffer* self);
+
+} ByteRingbuffer;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new ByteRingbuffer.
+ * @param capacity_bytes minimum number of bytes this ringbuffer can hold.
+ *        Is rounded up to the next power of two, check with capacity().
+ *        A single record, including its header of sizeof(size_t) bytes,
+ *        might take up at most half of it.
+ */
+ByteRingbuffer* byte_ringbuffer_create(size_t capacity_bytes);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -35,6 +35,7 @@
 #define __CACHING_RINGBUFFER_H__
 /*----------------------------------------------------------------------------*/
 
+#include "ringbuffer.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <inttypes.h>
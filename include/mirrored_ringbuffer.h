@@ -0,0 +1,113 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides a ringbuffer for byte streams whose memory is mapped
+ * twice back to back. See the MirroredRingbuffer struct.
+ */
+#ifndef __MIRRORED_RINGBUFFER_H__
+#define __MIRRORED_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A mirrored ringbuffer is a first-in first-out queue of bytes.
+ * Its memory is mapped twice in a row, thus the free as well as the used
+ * bytes can always be accessed as one contiguous span, regardless of
+ * where the ringbuffer wraps around.
+ * Spans can directly be handed to memcpy, read(2), write(2) or parsers.
+ * One thread might produce while another thread consumes concurrently
+ * without any further synchronization.
+ */
+typedef struct MirroredRingbuffer {
+
+    /**
+     * Get the number of bytes this ringbuffer can hold.
+     */
+    size_t        (*capacity)   (struct MirroredRingbuffer* self);
+
+    /**
+     * Get the free bytes of the ringbuffer.
+     * @param length receives the number of contiguous bytes that might be written
+     * @return pointer to the free bytes
+     */
+    uint8_t*      (*write_span) (struct MirroredRingbuffer* self, size_t* length);
+
+    /**
+     * Make bytes written to the span returned by write_span available
+     * to the consumer.
+     * @return true on success, false if length exceeds the free bytes
+     */
+    bool          (*produce)    (struct MirroredRingbuffer* self, size_t length);
+
+    /**
+     * Get the oldest bytes of the ringbuffer without removing them.
+     * @param length receives the number of contiguous bytes that might be read
+     * @return pointer to the oldest bytes
+     */
+    uint8_t*      (*read_span)  (struct MirroredRingbuffer* self, size_t* length);
+
+    /**
+     * Remove the oldest length bytes.
+     * @return true on success, false if length exceeds the used bytes
+     */
+    bool          (*consume)    (struct MirroredRingbuffer* self, size_t length);
+
+    /**
+     * Free this ringbuffer and unmap its memory.
+     * @return 0 on success or self in case of error.
+     */
+    struct MirroredRingbuffer* (*free) (struct MirroredRingbuffer* self);
+
+} MirroredRingbuffer;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new MirroredRingbuffer.
+ * Only supported on Linux.
+ * @param capacity_bytes minimum number of bytes this ringbuffer can hold.
+ *        Is rounded up to the next power of two that is a multiple of the
+ *        page size, check with capacity().
+ * @return the new ringbuffer or 0 in case of error
+ */
+MirroredRingbuffer* mirrored_ringbuffer_create(size_t capacity_bytes);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
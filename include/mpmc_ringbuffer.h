@@ -0,0 +1,85 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __MPMC_RINGBUFFER_H__
+#define __MPMC_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new lock-free multi-producer/multi-consumer Ringbuffer.
+ * Any number of threads might call add and pop concurrently.
+ * Unlike ringbuffer_create, elements are never overwritten:
+ * If the ringbuffer is full, add fails and returns false.
+ * Since pop signals an empty ringbuffer by returning 0, 0 cannot be added.
+ * Waiting for the ringbuffer is not supported, see
+ * mpmc_ringbuffer_create_with_policy.
+ * resize rounds up to the next power of two as well and must not be called
+ * concurrently with any other function of the ringbuffer.
+ * @param capacity minimum number of elements this ringbuffer can hold.
+ *        Is rounded up to the next power of two, check with capacity().
+ * @param free_item function to free elements still contained on free. Might be 0.
+ * @param free_item_additional_arg arbitrary pointer handed over to free_item
+ * @see ringbuffer_create
+ */
+Ringbuffer* mpmc_ringbuffer_create(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new lock-free multi-producer/multi-consumer Ringbuffer with a specific
+ * policy for adding to a full ringbuffer.
+ * Overwriting elements is not supported, thus RINGBUFFER_OVERWRITE is not
+ * supported.
+ * To wait for the ringbuffer via pop_wait, add_wait or event_fd, it
+ * has to be created with RINGBUFFER_WAITABLE, which RINGBUFFER_BLOCK implies.
+ * @param policy either RINGBUFFER_REJECT or RINGBUFFER_BLOCK, optionally
+ *        or'ed with RINGBUFFER_WAITABLE
+ * @return the new ringbuffer or 0 in case of error or unsupported policy
+ * @see mpmc_ringbuffer_create
+ */
+Ringbuffer* mpmc_ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides deferred, batched freeing of elements.
+ * See the Reclaimer struct.
+ */
+#ifndef __RECLAIMER_H__
+#define __RECLAIMER_H__
+/*----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A reclaimer collects elements that should be freed and hands them over
+ * to free_items in batches later on.
+ * Hand reclaimer_free_item as free_item to a ringbuffer to take freeing
+ * overwritten elements off the thread that adds.
+ *
+ * One thread might call collect and flush, while any thread calls reclaim
+ * concurrently, e.g. the thread that pops or a background thread.
+ */
+typedef struct Reclaimer {
+
+    /**
+     * Collect an element to be freed later on.
+     * If the batch is full and there is no empty batch left because
+     * reclaim did not run for too long, the full batch is handed
+     * to free_items right away.
+     * @return true on success, false in case of failure
+     */
+    bool          (*collect)  (struct Reclaimer* self, void* item);
+
+    /**
+     * Make the collected elements available to reclaim,
+     * even if the current batch is not full yet.
+     */
+    bool          (*flush)    (struct Reclaimer* self);
+
+    /**
+     * Hand all full batches to free_items.
+     * @return the number of elements freed
+     */
+    size_t        (*reclaim)  (struct Reclaimer* self);
+
+    /**
+     * Free all elements collected so far and the reclaimer itself.
+     * Must not be called concurrently with any other function.
+     * @return 0 on success or self in case of error.
+     */
+    struct Reclaimer* (*free) (struct Reclaimer* self);
+
+} Reclaimer;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Create a new Reclaimer.
+ * @param batch_size number of elements handed to free_items at once
+ * @param num_batches number of batches that might await reclaim
+ * @param free_items function to free n elements
+ * @param free_items_additional_arg arbitrary pointer handed over to free_items
+ * @return the new reclaimer or 0 in case of error
+ */
+Reclaimer* reclaimer_create(
+        size_t batch_size,
+        size_t num_batches,
+        void (*free_items)(void** items, size_t n, void* additional_arg),
+        void* free_items_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * To be handed as free_item to a ringbuffer, with the reclaimer as
+ * additional_arg.
+ */
+void reclaimer_free_item(void* item, void* reclaimer);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
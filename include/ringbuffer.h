@@ -40,6 +40,76 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Statistics about a ringbuffer since its creation.
+ * Counters that do not apply to a ringbuffer remain 0.
+ */
+typedef struct {
+
+    size_t adds;
+    size_t pops;
+
+    /** pop calls that did not return an element */
+    size_t empty_pops;
+
+    /** Elements dropped by add because the ringbuffer was full */
+    size_t overwrites;
+
+    /** Current number of elements */
+    size_t num_items;
+
+    /** Maximum number of elements ever contained at once */
+    size_t high_watermark;
+
+    /** Only for caching ringbuffers: Requests served from / missing the cache */
+    size_t cache_hits;
+    size_t cache_misses;
+
+} RingbufferStats;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Number of sub-buckets per power of two of a RingbufferLatency histogram,
+ * as a power of two
+ */
+#define RINGBUFFER_LATENCY_SUB_BITS 3
+
+#define RINGBUFFER_LATENCY_BUCKETS \
+    ((64 - RINGBUFFER_LATENCY_SUB_BITS + 1) << RINGBUFFER_LATENCY_SUB_BITS)
+
+/**
+ * Histogram of the times elements spent in a ringbuffer, in nanoseconds.
+ * Buckets are logarithmic: Every power of two is split into
+ * 2^RINGBUFFER_LATENCY_SUB_BITS linear sub-buckets, thus the relative error
+ * is below 2^-RINGBUFFER_LATENCY_SUB_BITS.
+ * See ringbuffer_latency.h on how to evaluate it.
+ */
+typedef struct {
+
+    size_t counts[RINGBUFFER_LATENCY_BUCKETS];
+    size_t num_samples;
+
+} RingbufferLatency;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Conditions a ringbuffer might signal via a file descriptor, see event_fd.
+ */
+typedef enum {
+
+    /** The ringbuffer might contain elements */
+    RINGBUFFER_NOT_EMPTY,
+
+    /** The ringbuffer might accept elements */
+    RINGBUFFER_NOT_FULL,
+
+} RingbufferEvent;
 
 /*----------------------------------------------------------------------------*/
 
@@ -69,6 +139,94 @@ typedef struct Ringbuffer {
      */
     void*         (*pop)      (struct Ringbuffer* self);
 
+    /**
+     * Add up to n elements to this ringbuffer in one go.
+     * Behaves as if add was called for each element in order, but stops
+     * at the first element add would have failed for.
+     * @return the number of elements added
+     */
+    size_t        (*add_n)    (struct Ringbuffer* self, void** items, size_t n);
+
+    /**
+     * Retrieve up to max of the oldest elements from the ringbuffer.
+     * The elements are written to out, oldest first, and removed from the
+     * ringbuffer.
+     * @return the number of elements written to out
+     */
+    size_t        (*pop_n)    (struct Ringbuffer* self, void** out, size_t max);
+
+    /**
+     * Like pop, but waits for an element to become available if the
+     * ringbuffer is empty.
+     * Ringbuffers that are not thread-safe cannot be filled while waiting
+     * and return immediately, as do thread-safe ones not created waitable,
+     * see RINGBUFFER_WAITABLE.
+     * @param timeout_usecs maximum time to wait, negative to wait forever
+     * @return the oldest element or 0 if none became available in time
+     */
+    void*         (*pop_wait) (struct Ringbuffer* self, int64_t timeout_usecs);
+
+    /**
+     * Like add, but waits for space to become available if the
+     * ringbuffer is full and does not overwrite elements.
+     * Ringbuffers that overwrite elements or were not created waitable
+     * never wait, see RINGBUFFER_WAITABLE.
+     * @param timeout_usecs maximum time to wait, negative to wait forever
+     * @return true on success, false if no space became available in time
+     */
+    bool          (*add_wait) (struct Ringbuffer* self, void* item,
+                               int64_t timeout_usecs);
+
+    /**
+     * Change the number of elements this ringbuffer might hold.
+     * Elements contained are kept in order.
+     * If there are more elements than new_capacity, the oldest ones are
+     * removed and handed to free_item.
+     * Thread-safe ringbuffers document whether resize might be called
+     * concurrently.
+     * @return true on success, false in case of failure
+     */
+    bool          (*resize)   (struct Ringbuffer* self, size_t new_capacity);
+
+    /**
+     * Get statistics about this ringbuffer.
+     * Statistics are only kept if compiled with RINGBUFFER_STATS defined.
+     * In a thread-safe ringbuffer, the counters are not updated in sync,
+     * thus the values might be slightly inconsistent while elements are
+     * added/popped.
+     * @return true on success, false in case of failure or if statistics
+     *         are not kept
+     */
+    bool          (*stats)    (struct Ringbuffer* self, RingbufferStats* stats);
+
+    /**
+     * Get a histogram of how long elements stayed in the ringbuffer until
+     * they were popped.
+     * Latencies are only recorded if compiled with RINGBUFFER_LATENCY
+     * defined.
+     * Should be called by one thread at a time only.
+     * @param reset if true, the histogram starts over afterwards
+     * @return true on success, false in case of failure or if latencies are
+     *         not recorded
+     */
+    bool          (*latency)  (struct Ringbuffer* self,
+                               RingbufferLatency* latency, bool reset);
+
+    /**
+     * Get a file descriptor that becomes readable once event occurs, e.g.
+     * to wait for the ringbuffer with epoll alongside sockets.
+     * The descriptor is created on the first call and remains owned by the
+     * ringbuffer. It is never read or written by the caller.
+     * Signals are coalesced: The descriptor stays readable until a pop
+     * finds the ringbuffer empty (RINGBUFFER_NOT_EMPTY) or an add finds it
+     * full (RINGBUFFER_NOT_FULL), thus pop / add until they fail before
+     * waiting again.
+     * Only thread-safe ringbuffers that do not overwrite elements and were
+     * created waitable support this, see RINGBUFFER_WAITABLE.
+     * @return the file descriptor or -1 in case of failure / if not supported
+     */
+    int           (*event_fd) (struct Ringbuffer* self, RingbufferEvent event);
+
     /**
      * Free this ringbuffer and all elements contained within.
      * @return 0 on success or self in case of error.
@@ -79,6 +237,34 @@ typedef struct Ringbuffer {
 
 /*----------------------------------------------------------------------------*/
 
+/**
+ * What add does if the ringbuffer is full.
+ * Not every implementation supports every policy.
+ */
+typedef enum {
+
+    /** Overwrite the oldest element, which is handed to free_item */
+    RINGBUFFER_OVERWRITE,
+
+    /** Fail and return false */
+    RINGBUFFER_REJECT,
+
+    /** Wait until there is space, like add_wait without timeout */
+    RINGBUFFER_BLOCK,
+
+    /**
+     * Not a policy on its own, but to be or'ed to one, e.g.
+     * RINGBUFFER_REJECT | RINGBUFFER_WAITABLE.
+     * Thread-safe ringbuffers support pop_wait, add_wait and event_fd only
+     * if created with this flag or RINGBUFFER_BLOCK, since then every add
+     * and pop has to check for waiting threads, which costs a memory fence.
+     */
+    RINGBUFFER_WAITABLE = 0x100,
+
+} RingbufferPolicy;
+
+/*----------------------------------------------------------------------------*/
+
 /**
  * Create a new Ringbuffer.
  * @param capacity number of elements this ringbuffer can hold before overwriting elements.
@@ -92,4 +278,19 @@ Ringbuffer* ringbuffer_create(
 
 /*----------------------------------------------------------------------------*/
 
+/**
+ * Create a new Ringbuffer with a specific policy for adding to a full ringbuffer.
+ * Since this ringbuffer is not thread-safe, RINGBUFFER_BLOCK is not supported.
+ * @param policy either RINGBUFFER_OVERWRITE or RINGBUFFER_REJECT
+ * @return the new ringbuffer or 0 in case of error or unsupported policy
+ * @see ringbuffer_create
+ */
+Ringbuffer* ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg);
+
+/*----------------------------------------------------------------------------*/
+
 #endif
@@ -0,0 +1,121 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides functions to evaluate a RingbufferLatency histogram.
+ */
+#ifndef __RINGBUFFER_LATENCY_H__
+#define __RINGBUFFER_LATENCY_H__
+/*----------------------------------------------------------------------------*/
+
+#include "ringbuffer.h"
+
+/*----------------------------------------------------------------------------*/
+
+#define RINGBUFFER_LATENCY_SUB_BUCKETS (1 << RINGBUFFER_LATENCY_SUB_BITS)
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return index of the bucket nsecs falls into
+ */
+static inline size_t ringbuffer_latency_bucket(uint64_t nsecs) {
+
+    if(nsecs < RINGBUFFER_LATENCY_SUB_BUCKETS) {
+        return nsecs;
+    }
+
+    size_t msb = 63 - __builtin_clzll(nsecs);
+    size_t shift = msb - RINGBUFFER_LATENCY_SUB_BITS;
+
+    return ((msb - RINGBUFFER_LATENCY_SUB_BITS + 1)
+            << RINGBUFFER_LATENCY_SUB_BITS)
+        + ((nsecs >> shift) & (RINGBUFFER_LATENCY_SUB_BUCKETS - 1));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return smallest number of nanoseconds that falls into bucket
+ */
+static inline uint64_t ringbuffer_latency_bucket_start(size_t bucket) {
+
+    if(bucket < RINGBUFFER_LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    if(bucket >= RINGBUFFER_LATENCY_BUCKETS) {
+        return UINT64_MAX;
+    }
+
+    size_t shift = (bucket >> RINGBUFFER_LATENCY_SUB_BITS) - 1;
+    uint64_t sub_bucket = bucket & (RINGBUFFER_LATENCY_SUB_BUCKETS - 1);
+
+    return (RINGBUFFER_LATENCY_SUB_BUCKETS + sub_bucket) << shift;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @param percentile between 0 and 100
+ * @return number of nanoseconds that percentile of all elements stayed in the
+ *         ringbuffer at most, rounded up to the end of its bucket
+ */
+static inline uint64_t ringbuffer_latency_percentile(
+        RingbufferLatency* latency, double percentile) {
+
+    if((0 == latency) || (0 == latency->num_samples)) {
+        return 0;
+    }
+
+    size_t num_samples = 0;
+
+    for(size_t bucket = 0; bucket < RINGBUFFER_LATENCY_BUCKETS; ++bucket) {
+
+        num_samples += latency->counts[bucket];
+
+        if(100.0 * num_samples >= percentile * latency->num_samples) {
+            return ringbuffer_latency_bucket_start(bucket + 1) - 1;
+        }
+
+    }
+
+    return UINT64_MAX;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file provides a generator for type-specialized ringbuffers.
+ * See RINGBUFFER_DEFINE.
+ */
+#ifndef __TYPED_RINGBUFFER_H__
+#define __TYPED_RINGBUFFER_H__
+/*----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Define a ringbuffer type `name` holding up to `capacity` elements of
+ * type `type` by value, along with these functions:
+ *
+ *     void   name_init(name* self);
+ *     size_t name_capacity(const name* self);
+ *     size_t name_num_items(const name* self);
+ *     bool   name_add(name* self, type item);
+ *     bool   name_pop(name* self, type* item);
+ *
+ * Just like a Ringbuffer, adding to a full ringbuffer overwrites the
+ * oldest element. name_pop returns false if the ringbuffer is empty.
+ *
+ * All functions are static inline and there is no function table,
+ * thus the compiler is free to inline all of them.
+ * The ringbuffer itself requires no allocation, it might as well be placed
+ * on the stack or embedded into another struct.
+ * Not thread-safe.
+ *
+ * Example:
+ *
+ *     RINGBUFFER_DEFINE(U64Ringbuffer, uint64_t, 64)
+ *
+ *     U64Ringbuffer buffer;
+ *     U64Ringbuffer_init(&buffer);
+ *     U64Ringbuffer_add(&buffer, 42);
+ */
+#define RINGBUFFER_DEFINE(name, type, capacity)                               \
+                                                                              \
+    _Static_assert(0 < (capacity), "capacity must be positive");             \
+                                                                              \
+    typedef struct name {                                                     \
+        size_t next_index_to_read;                                            \
+        size_t num_items;                                                     \
+        type items[capacity];                                                 \
+    } name;                                                                   \
+                                                                              \
+    static inline void name##_init(name* self) {                              \
+        self->next_index_to_read = 0;                                         \
+        self->num_items = 0;                                                  \
+    }                                                                         \
+                                                                              \
+    static inline size_t name##_capacity(const name* self) {                  \
+        return (capacity);                                                    \
+    }                                                                         \
+                                                                              \
+    static inline size_t name##_num_items(const name* self) {                 \
+        return self->num_items;                                               \
+    }                                                                         \
+                                                                              \
+    static inline bool name##_add(name* self, type item) {                    \
+        size_t write = self->next_index_to_read + self->num_items;            \
+        if(write >= (capacity)) {                                             \
+            write -= (capacity);                                              \
+        }                                                                     \
+        self->items[write] = item;                                            \
+        if(self->num_items < (capacity)) {                                    \
+            ++self->num_items;                                                \
+        } else if(++self->next_index_to_read == (capacity)) {                 \
+            self->next_index_to_read = 0;                                     \
+        }                                                                     \
+        return true;                                                          \
+    }                                                                         \
+                                                                              \
+    static inline bool name##_pop(name* self, type* item) {                   \
+        if(0 == self->num_items) {                                            \
+            return false;                                                     \
+        }                                                                     \
+        *item = self->items[self->next_index_to_read];                        \
+        if(++self->next_index_to_read == (capacity)) {                        \
+            self->next_index_to_read = 0;                                     \
+        }                                                                     \
+        --self->num_items;                                                    \
+        return true;                                                          \
+    }
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,713 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/array_ringbuffer.h"
+#include "stats.h"
+#include "latency.h"
+#include <string.h>
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(Ringbuffer* self);
+
+static bool add_func(Ringbuffer* self, void* item);
+
+static void* pop_func(Ringbuffer* self);
+
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool add_reject_func(Ringbuffer* self, void* item);
+
+static size_t add_n_reject_func(Ringbuffer* self, void** items, size_t n);
+
+static bool add_wait_reject_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* free_func(Ringbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+typedef struct InternalRingbuffer {
+
+    Ringbuffer public;
+
+    size_t next_index_to_read;
+    size_t next_index_to_write;
+    size_t num_items;
+    size_t max_num_items;
+
+    /* capacity - 1 if capacity is a power of two, 0 otherwise */
+    size_t index_mask;
+
+    void (*free_item)(void* item, void* additional_arg);
+    void* free_item_additional_arg;
+
+    /* Points to inline_items until the first resize */
+    void** items;
+
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+    PopStats pop_stats;
+#endif
+
+#if defined(RINGBUFFER_LATENCY)
+    /* Time each element was added, parallel to items */
+    uint64_t* timestamps;
+    Histogram latency;
+#endif
+
+    void* inline_items[];
+
+} InternalRingbuffer;
+
+/*----------------------------------------------------------------------------*/
+
+static inline size_t index_mask_for(size_t capacity) {
+
+    if(0 == (capacity & (capacity - 1))) {
+        return capacity - 1;
+    }
+
+    return 0;
+
+}
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+Ringbuffer* array_ringbuffer_create(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    return array_ringbuffer_create_with_policy(capacity, RINGBUFFER_OVERWRITE,
+            free_item, free_item_additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* array_ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    if(0 >= capacity) {
+        goto error;
+    }
+
+    if((RINGBUFFER_OVERWRITE != policy) && (RINGBUFFER_REJECT != policy)) {
+        goto error;
+    }
+
+    if(capacity > (SIZE_MAX - sizeof(InternalRingbuffer)) / sizeof(void*)) {
+        goto error;
+    }
+
+    InternalRingbuffer* buffer =
+        calloc(1, sizeof(InternalRingbuffer) + capacity * sizeof(void*));
+
+    if(0 == buffer) goto error;
+
+    buffer->items = buffer->inline_items;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    buffer->timestamps = calloc(capacity, sizeof(uint64_t));
+
+    if(0 == buffer->timestamps) {
+        free(buffer);
+        goto error;
+    }
+
+#endif
+
+    buffer->max_num_items = capacity;
+    buffer->index_mask = index_mask_for(capacity);
+    buffer->free_item = free_item;
+    buffer->free_item_additional_arg = free_item_additional_arg;
+
+    buffer->public = (Ringbuffer) {
+        .capacity = capacity_func,
+        .add = add_func,
+        .pop = pop_func,
+        .add_n = add_n_func,
+        .pop_n = pop_n_func,
+        .pop_wait = pop_wait_func,
+        .add_wait = add_wait_func,
+        .resize = resize_func,
+        .stats = stats_func,
+        .latency = latency_func,
+        .event_fd = event_fd_func,
+        .free = free_func,
+    };
+
+    if(RINGBUFFER_REJECT == policy) {
+        buffer->public.add = add_reject_func;
+        buffer->public.add_n = add_n_reject_func;
+        buffer->public.add_wait = add_wait_reject_func;
+    }
+
+    return (Ringbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static inline size_t next_index(InternalRingbuffer* internal, size_t index) {
+
+    ++index;
+
+    if(0 != internal->index_mask) {
+        return index & internal->index_mask;
+    }
+
+    return (index == internal->max_num_items) ? 0 : index;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    return internal->max_num_items;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(internal->num_items == internal->max_num_items) {
+
+        size_t read = internal->next_index_to_read;
+
+        if((0 != internal->items[read]) && (0 != internal->free_item)) {
+            internal->free_item(
+                    internal->items[read],
+                    internal->free_item_additional_arg);
+        }
+
+        internal->next_index_to_read = next_index(internal, read);
+        --internal->num_items;
+
+        STATS_ADD(&internal->add_stats.overwrites, 1);
+
+    }
+
+    size_t write = internal->next_index_to_write;
+
+    LATENCY_NOW(now);
+    LATENCY_STAMP(internal->timestamps[write], now);
+
+    internal->items[write] = item;
+    internal->next_index_to_write = next_index(internal, write);
+    ++internal->num_items;
+
+    STATS_ADD(&internal->add_stats.adds, 1);
+    STATS_WATERMARK(&internal->add_stats.high_watermark, internal->num_items);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(0 == internal->num_items) {
+        STATS_ADD(&internal->pop_stats.empty_pops, 1);
+        return 0;
+    }
+
+    size_t read = internal->next_index_to_read;
+
+    LATENCY_NOW(now);
+    LATENCY_RECORD(&internal->latency, internal->timestamps[read], now);
+
+    void* retval = internal->items[read];
+    internal->items[read] = 0;
+    internal->next_index_to_read = next_index(internal, read);
+    --internal->num_items;
+
+    STATS_ADD(&internal->pop_stats.pops, 1);
+
+    return retval;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Requires n free slots
+ */
+static inline void copy_in(
+        InternalRingbuffer* internal, void** items, size_t n) {
+
+    size_t write = internal->next_index_to_write;
+    size_t first_chunk = internal->max_num_items - write;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    uint64_t now = latency_now();
+
+    for(size_t i = 0, index = write; i < n; ++i) {
+        internal->timestamps[index] = now;
+        index = next_index(internal, index);
+    }
+
+#endif
+
+    if(first_chunk > n) {
+        first_chunk = n;
+    }
+
+    memcpy(internal->items + write, items, first_chunk * sizeof(void*));
+    memcpy(internal->items, items + first_chunk,
+            (n - first_chunk) * sizeof(void*));
+
+    write += n;
+
+    if(write >= internal->max_num_items) {
+        write -= internal->max_num_items;
+    }
+
+    internal->next_index_to_write = write;
+    internal->num_items += n;
+
+    STATS_ADD(&internal->add_stats.adds, n);
+    STATS_WATERMARK(&internal->add_stats.high_watermark, internal->num_items);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(n > internal->max_num_items - internal->num_items) {
+
+        /* Elements will be overwritten - requires freeing them one by one */
+        for(size_t i = 0; i < n; ++i) {
+            add_func(self, items[i]);
+        }
+
+        return n;
+
+    }
+
+    copy_in(internal, items, n);
+
+    return n;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+    if(0 == out) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(max > internal->num_items) {
+        max = internal->num_items;
+    }
+
+    size_t read = internal->next_index_to_read;
+    size_t first_chunk = internal->max_num_items - read;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    uint64_t now = latency_now();
+
+    for(size_t i = 0, index = read; i < max; ++i) {
+        latency_record(&internal->latency, internal->timestamps[index], now);
+        index = next_index(internal, index);
+    }
+
+#endif
+
+    if(first_chunk > max) {
+        first_chunk = max;
+    }
+
+    memcpy(out, internal->items + read, first_chunk * sizeof(void*));
+    memcpy(out + first_chunk, internal->items,
+            (max - first_chunk) * sizeof(void*));
+
+    read += max;
+
+    if(read >= internal->max_num_items) {
+        read -= internal->max_num_items;
+    }
+
+    internal->next_index_to_read = read;
+    internal->num_items -= max;
+
+    STATS_ADD(&internal->pop_stats.pops, max);
+
+    return max;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Nobody could add an element while waiting - thus just pop
+ */
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Elements are overwritten, thus add never has to wait
+ */
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_reject_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(internal->num_items == internal->max_num_items) goto error;
+
+    size_t write = internal->next_index_to_write;
+
+    LATENCY_NOW(now);
+    LATENCY_STAMP(internal->timestamps[write], now);
+
+    internal->items[write] = item;
+    internal->next_index_to_write = next_index(internal, write);
+    ++internal->num_items;
+
+    STATS_ADD(&internal->add_stats.adds, 1);
+    STATS_WATERMARK(&internal->add_stats.high_watermark, internal->num_items);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_reject_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(n > internal->max_num_items - internal->num_items) {
+        n = internal->max_num_items - internal->num_items;
+    }
+
+    copy_in(internal, items, n);
+
+    return n;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Nobody could pop an element while waiting - thus just add
+ */
+static bool add_wait_reject_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return add_reject_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+    if(0 == new_capacity) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    void** items = calloc(new_capacity, sizeof(void*));
+
+    if(0 == items) goto error;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    uint64_t* timestamps = calloc(new_capacity, sizeof(uint64_t));
+
+    if(0 == timestamps) {
+        free(items);
+        goto error;
+    }
+
+#endif
+
+    size_t read = internal->next_index_to_read;
+    size_t num_items = internal->num_items;
+
+    for(; num_items > new_capacity; --num_items) {
+
+        STATS_ADD(&internal->add_stats.overwrites, 1);
+
+        if((0 != internal->items[read]) && (0 != internal->free_item)) {
+            internal->free_item(
+                    internal->items[read],
+                    internal->free_item_additional_arg);
+        }
+
+        read = next_index(internal, read);
+
+    }
+
+    for(size_t i = 0; i < num_items; ++i) {
+        items[i] = internal->items[read];
+        LATENCY_STAMP(timestamps[i], internal->timestamps[read]);
+        read = next_index(internal, read);
+    }
+
+    if(internal->inline_items != internal->items) {
+        free(internal->items);
+    }
+
+    internal->items = items;
+
+#if defined(RINGBUFFER_LATENCY)
+    free(internal->timestamps);
+    internal->timestamps = timestamps;
+#endif
+
+    internal->next_index_to_read = 0;
+    internal->next_index_to_write = (num_items == new_capacity) ? 0 : num_items;
+    internal->num_items = num_items;
+    internal->max_num_items = new_capacity;
+    internal->index_mask = index_mask_for(new_capacity);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    stats_get(stats, &internal->add_stats, &internal->pop_stats,
+            internal->num_items);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    if(0 == self) goto error;
+    if(0 == latency) goto error;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    latency_get(&internal->latency, latency, reset);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Not thread-safe, thus there is nobody to wait for the ringbuffer.
+ */
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(0 != internal->free_item) {
+
+        size_t read = internal->next_index_to_read;
+
+        for(size_t i = 0; i < internal->num_items; ++i) {
+
+            if(0 != internal->items[read]) {
+                internal->free_item(
+                        internal->items[read],
+                        internal->free_item_additional_arg);
+            }
+
+            read = next_index(internal, read);
+
+        }
+
+    }
+
+    if(internal->inline_items != internal->items) {
+        free(internal->items);
+    }
+
+#if defined(RINGBUFFER_LATENCY)
+    free(internal->timestamps);
+#endif
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
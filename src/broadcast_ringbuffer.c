@@ -0,0 +1,570 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/broadcast_ringbuffer.h"
+#include "waiter.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(BroadcastRingbuffer* self);
+
+static size_t num_readers_func(BroadcastRingbuffer* self);
+
+static bool add_func(BroadcastRingbuffer* self, void* item);
+
+static bool add_block_func(BroadcastRingbuffer* self, void* item);
+
+static bool add_overwrite_func(BroadcastRingbuffer* self, void* item);
+
+static void* peek_func(BroadcastRingbuffer* self, size_t reader);
+
+static void* peek_overwrite_func(BroadcastRingbuffer* self, size_t reader);
+
+static bool release_func(BroadcastRingbuffer* self, size_t reader);
+
+static BroadcastRingbuffer* free_func(BroadcastRingbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * Each reader gets a cache line of its own.
+ */
+typedef struct {
+
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_read;
+    size_t cached_next_to_write;
+
+} Cursor;
+
+/**
+ * Like in the spsc_ringbuffer, the counters are never wrapped and the slot is
+ * determined by masking with index_mask.
+ *
+ * With RINGBUFFER_REJECT/RINGBUFFER_BLOCK, the producer caches the position of
+ * the slowest reader and only scans all cursors if the copy indicates a
+ * full ringbuffer.
+ *
+ * With RINGBUFFER_OVERWRITE, the producer never looks at the cursors.
+ * Before writing a slot, it announces the position in next_to_claim.
+ * A reader that reads an element checks next_to_claim afterwards to see
+ * whether the slot has been overwritten meanwhile (like a seqlock).
+ */
+typedef struct InternalRingbuffer {
+
+    BroadcastRingbuffer public;
+
+    size_t max_num_items;
+    size_t index_mask;
+    size_t num_readers;
+    _Atomic(void*)* items;
+    Cursor* cursors;
+
+    void (*free_item)(void* item, void* additional_arg);
+    void* free_item_additional_arg;
+
+    /* Set on creation only: Whether release notifies a blocked producer */
+    bool waitable;
+
+    /* Written by producer only */
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_write;
+    atomic_size_t next_to_claim;
+    size_t cached_min_next_to_read;
+
+    alignas(CACHE_LINE_SIZE) Waiter not_full;
+
+} InternalRingbuffer;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+BroadcastRingbuffer* broadcast_ringbuffer_create(
+        size_t capacity,
+        size_t num_readers,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    if(0 >= capacity) goto error;
+    if(0 >= num_readers) goto error;
+
+    if((RINGBUFFER_OVERWRITE == policy) && (0 != free_item)) {
+        goto error;
+    }
+
+    size_t num_slots = 1;
+
+    while(num_slots < capacity) {
+        num_slots <<= 1;
+    }
+
+    InternalRingbuffer* buffer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalRingbuffer));
+
+    if(0 == buffer) goto error;
+
+    memset(buffer, 0, sizeof(InternalRingbuffer));
+
+    buffer->items = calloc(num_slots, sizeof(_Atomic(void*)));
+    buffer->cursors =
+        aligned_alloc(CACHE_LINE_SIZE, num_readers * sizeof(Cursor));
+
+    if((0 == buffer->items) || (0 == buffer->cursors)) {
+        free(buffer->items);
+        free(buffer->cursors);
+        free(buffer);
+        goto error;
+    }
+
+    for(size_t i = 0; i < num_slots; ++i) {
+        atomic_init(buffer->items + i, 0);
+    }
+
+    for(size_t i = 0; i < num_readers; ++i) {
+        atomic_init(&buffer->cursors[i].next_to_read, 0);
+        buffer->cursors[i].cached_next_to_write = 0;
+    }
+
+    buffer->max_num_items = num_slots;
+    buffer->index_mask = num_slots - 1;
+    buffer->num_readers = num_readers;
+    buffer->free_item = free_item;
+    buffer->free_item_additional_arg = free_item_additional_arg;
+
+    atomic_init(&buffer->next_to_write, 0);
+    atomic_init(&buffer->next_to_claim, 0);
+
+    waiter_init(&buffer->not_full);
+
+    buffer->public = (BroadcastRingbuffer) {
+        .capacity = capacity_func,
+        .num_readers = num_readers_func,
+        .add = add_func,
+        .peek = peek_func,
+        .release = release_func,
+        .free = free_func,
+    };
+
+    switch(policy) {
+
+        case RINGBUFFER_REJECT:
+            break;
+
+        case RINGBUFFER_BLOCK:
+            buffer->waitable = true;
+            buffer->public.add = add_block_func;
+            break;
+
+        case RINGBUFFER_OVERWRITE:
+            buffer->public.add = add_overwrite_func;
+            buffer->public.peek = peek_overwrite_func;
+            break;
+
+        default:
+            free_func((BroadcastRingbuffer*)buffer);
+            goto error;
+
+    }
+
+    return (BroadcastRingbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static size_t capacity_func(BroadcastRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    return internal->max_num_items;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t num_readers_func(BroadcastRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    return internal->num_readers;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t min_next_to_read(InternalRingbuffer* internal, size_t write) {
+
+    size_t min = write;
+
+    for(size_t i = 0; i < internal->num_readers; ++i) {
+
+        size_t read = atomic_load_explicit(
+                &internal->cursors[i].next_to_read, memory_order_acquire);
+
+        if(write - read > write - min) {
+            min = read;
+        }
+
+    }
+
+    return min;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_func(BroadcastRingbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    if(write - internal->cached_min_next_to_read == internal->max_num_items) {
+
+        internal->cached_min_next_to_read = min_next_to_read(internal, write);
+
+        if(write - internal->cached_min_next_to_read ==
+                internal->max_num_items) {
+            goto error;
+        }
+
+    }
+
+    _Atomic(void*)* slot = internal->items + (write & internal->index_mask);
+
+    /* Every reader released the previous element of this slot */
+    void* old = atomic_load_explicit(slot, memory_order_relaxed);
+
+    if((0 != old) && (0 != internal->free_item)) {
+        internal->free_item(old, internal->free_item_additional_arg);
+    }
+
+    atomic_store_explicit(slot, item, memory_order_relaxed);
+
+    atomic_store_explicit(
+            &internal->next_to_write, write + 1, memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_block_func(BroadcastRingbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(add_func(self, item)) {
+        return true;
+    }
+
+    for(size_t i = 0; i < WAITER_SPIN_COUNT; ++i) {
+
+        waiter_pause();
+
+        if(add_func(self, item)) {
+            return true;
+        }
+
+    }
+
+    bool added = false;
+
+    while(! added) {
+
+        unsigned sequence = waiter_register(&internal->not_full);
+
+        added = add_func(self, item);
+
+        if(! added) {
+            waiter_sleep(&internal->not_full, sequence, 0);
+        }
+
+        waiter_unregister(&internal->not_full);
+
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_overwrite_func(BroadcastRingbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    atomic_store_explicit(
+            &internal->next_to_claim, write + 1, memory_order_relaxed);
+
+    /* Orders the claim before the element store, pairs with the acquire
+     * fence in peek_overwrite_func */
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(internal->items + (write & internal->index_mask),
+            item, memory_order_relaxed);
+
+    atomic_store_explicit(
+            &internal->next_to_write, write + 1, memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* peek_func(BroadcastRingbuffer* self, size_t reader) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(reader >= internal->num_readers) goto error;
+
+    Cursor* cursor = internal->cursors + reader;
+
+    size_t read =
+        atomic_load_explicit(&cursor->next_to_read, memory_order_relaxed);
+
+    if(read == cursor->cached_next_to_write) {
+
+        cursor->cached_next_to_write = atomic_load_explicit(
+                &internal->next_to_write, memory_order_acquire);
+
+        if(read == cursor->cached_next_to_write) {
+            goto error;
+        }
+
+    }
+
+    return atomic_load_explicit(
+            internal->items + (read & internal->index_mask),
+            memory_order_relaxed);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* peek_overwrite_func(BroadcastRingbuffer* self, size_t reader) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(reader >= internal->num_readers) goto error;
+
+    Cursor* cursor = internal->cursors + reader;
+
+    size_t read =
+        atomic_load_explicit(&cursor->next_to_read, memory_order_relaxed);
+
+    for(;;) {
+
+        size_t write = atomic_load_explicit(
+                &internal->next_to_write, memory_order_acquire);
+
+        if(read == write) break;
+
+        if(write - read > internal->max_num_items) {
+            /* Lapped by the producer - skip the lost elements */
+            read = write - internal->max_num_items;
+        }
+
+        void* item = atomic_load_explicit(
+                internal->items + (read & internal->index_mask),
+                memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire);
+
+        size_t claimed = atomic_load_explicit(
+                &internal->next_to_claim, memory_order_relaxed);
+
+        if(claimed - read <= internal->max_num_items) {
+
+            atomic_store_explicit(
+                    &cursor->next_to_read, read, memory_order_relaxed);
+            cursor->cached_next_to_write = write;
+
+            return item;
+
+        }
+
+        /* Slot has been overwritten while reading it */
+        read = claimed - internal->max_num_items;
+
+    }
+
+    atomic_store_explicit(&cursor->next_to_read, read, memory_order_relaxed);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool release_func(BroadcastRingbuffer* self, size_t reader) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(reader >= internal->num_readers) goto error;
+
+    Cursor* cursor = internal->cursors + reader;
+
+    size_t read =
+        atomic_load_explicit(&cursor->next_to_read, memory_order_relaxed);
+
+    if(read == cursor->cached_next_to_write) {
+
+        cursor->cached_next_to_write = atomic_load_explicit(
+                &internal->next_to_write, memory_order_acquire);
+
+        if(read == cursor->cached_next_to_write) {
+            goto error;
+        }
+
+    }
+
+    atomic_store_explicit(
+            &cursor->next_to_read, read + 1, memory_order_release);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static BroadcastRingbuffer* free_func(BroadcastRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(0 != internal->free_item) {
+
+        for(size_t i = 0; i < internal->max_num_items; ++i) {
+
+            void* item =
+                atomic_load_explicit(internal->items + i, memory_order_relaxed);
+
+            if(0 != item) {
+                internal->free_item(item, internal->free_item_additional_arg);
+            }
+
+        }
+
+    }
+
+    free(internal->items);
+    free(internal->cursors);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,255 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/buffer_chain.h"
+#include <string.h>
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t append_func(BufferChain* self, const void* data, size_t num_bytes);
+
+static size_t length_func(BufferChain* self);
+
+static size_t iovec_func(BufferChain* self, struct iovec* iov, size_t max_iov);
+
+static void release_func(BufferChain* self);
+
+static BufferChain* free_func(BufferChain* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * Segments are linked from first to last via Buffer.next.
+ * Only the last segment might have space left.
+ */
+typedef struct {
+
+    BufferChain public;
+
+    Ringbuffer* cache;
+    size_t segment_size;
+
+    Buffer* first;
+    Buffer* last;
+    size_t length;
+
+} InternalBufferChain;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+BufferChain* buffer_chain_create(Ringbuffer* cache, size_t segment_size) {
+
+    if(0 == segment_size) goto error;
+
+    InternalBufferChain* chain = calloc(1, sizeof(InternalBufferChain));
+
+    if(0 == chain) goto error;
+
+    chain->cache = cache;
+    chain->segment_size = segment_size;
+
+    chain->public = (BufferChain) {
+        .append = append_func,
+        .length = length_func,
+        .iovec = iovec_func,
+        .release = release_func,
+        .free = free_func,
+    };
+
+    return (BufferChain*) chain;
+
+error:
+
+    return 0;
+
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static size_t append_func(BufferChain* self, const void* data, size_t num_bytes) {
+
+    if(0 == self) goto error;
+    if(0 == data) goto error;
+
+    InternalBufferChain* chain = (InternalBufferChain*) self;
+
+    const uint8_t* source = data;
+    size_t num_appended = 0;
+
+    while(num_appended < num_bytes) {
+
+        Buffer* last = chain->last;
+
+        if((0 == last) || (last->bytes_used == last->capacity_bytes)) {
+
+            last = buffercache_get_buffer(chain->cache, chain->segment_size);
+
+            if(0 == last) {
+                break;
+            }
+
+            last->next = 0;
+
+            if(0 == chain->first) {
+                chain->first = last;
+            } else {
+                chain->last->next = last;
+            }
+
+            chain->last = last;
+
+        }
+
+        size_t space = last->capacity_bytes - last->bytes_used;
+        size_t to_copy = num_bytes - num_appended;
+
+        if(space < to_copy) {
+            to_copy = space;
+        }
+
+        memcpy(last->data + last->bytes_used, source + num_appended, to_copy);
+
+        last->bytes_used += to_copy;
+        num_appended += to_copy;
+
+    }
+
+    chain->length += num_appended;
+
+    return num_appended;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t length_func(BufferChain* self) {
+
+    if(0 == self) goto error;
+
+    return ((InternalBufferChain*) self)->length;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t iovec_func(BufferChain* self, struct iovec* iov, size_t max_iov) {
+
+    if(0 == self) goto error;
+    if(0 == iov) goto error;
+
+    Buffer* segment = ((InternalBufferChain*) self)->first;
+    size_t num_iov = 0;
+
+    while((0 != segment) && (num_iov < max_iov)) {
+
+        iov[num_iov].iov_base = segment->data;
+        iov[num_iov].iov_len = segment->bytes_used;
+
+        ++num_iov;
+        segment = segment->next;
+
+    }
+
+    return num_iov;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void release_func(BufferChain* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferChain* chain = (InternalBufferChain*) self;
+    Buffer* segment = chain->first;
+
+    while(0 != segment) {
+
+        Buffer* next = segment->next;
+        segment->next = 0;
+
+        buffercache_release_or_free_buffer(chain->cache, segment);
+
+        segment = next;
+
+    }
+
+    chain->first = 0;
+    chain->last = 0;
+    chain->length = 0;
+
+error:
+
+    return;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static BufferChain* free_func(BufferChain* self) {
+
+    if(0 == self) goto error;
+
+    release_func(self);
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,567 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/buffer_depot.h"
+#include "stats.h"
+#include <pthread.h>
+#include <string.h>
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static Ringbuffer* create_cache_func(BufferDepot* self);
+
+static BufferDepot* free_func(BufferDepot* self);
+
+/*----------------------------------------------------------------------------*/
+
+static size_t cache_capacity_func(Ringbuffer* self);
+
+static bool cache_add_func(Ringbuffer* self, void* item);
+
+static void* cache_pop_func(Ringbuffer* self);
+
+static size_t cache_add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t cache_pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* cache_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool cache_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool cache_resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool cache_stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool cache_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int cache_event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* cache_free_func(Ringbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+typedef struct Magazine {
+
+    struct Magazine* next;
+    size_t num_items;
+    void* items[];
+
+} Magazine;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * The depot creates all of its max_magazines magazines up front.
+ * Caches swap magazines one for one, thus the depot always holds exactly
+ * max_magazines magazines, either in full or in empty.
+ * full might hold partially filled magazines as well.
+ */
+typedef struct {
+
+    BufferDepot public;
+
+    size_t magazine_size;
+
+    pthread_mutex_t lock;
+
+    Magazine* full;
+    Magazine* empty;
+
+} InternalBufferDepot;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Buffer s are popped from / pushed onto loaded.
+ * previous is kept as well to avoid swapping magazines with the depot
+ * over and over if gets and releases alternate at a magazine boundary.
+ */
+typedef struct {
+
+    Ringbuffer public;
+
+    InternalBufferDepot* depot;
+
+    Magazine* loaded;
+    Magazine* previous;
+
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+    PopStats pop_stats;
+#endif
+
+} DepotCache;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+static Magazine* magazine_create(size_t magazine_size) {
+
+    return calloc(1, sizeof(Magazine) + magazine_size * sizeof(void*));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+BufferDepot* buffer_depot_create(size_t magazine_size, size_t max_magazines) {
+
+    if(0 == magazine_size) goto error;
+
+    InternalBufferDepot* depot = calloc(1, sizeof(InternalBufferDepot));
+
+    if(0 == depot) goto error;
+
+    if(0 != pthread_mutex_init(&depot->lock, 0)) {
+        free(depot);
+        goto error;
+    }
+
+    depot->magazine_size = magazine_size;
+
+    depot->public = (BufferDepot) {
+        .create_cache = create_cache_func,
+        .free = free_func,
+    };
+
+    for(size_t i = 0; i < max_magazines; ++i) {
+
+        Magazine* magazine = magazine_create(magazine_size);
+
+        if(0 == magazine) {
+            free_func((BufferDepot*) depot);
+            goto error;
+        }
+
+        magazine->next = depot->empty;
+        depot->empty = magazine;
+
+    }
+
+    return (BufferDepot*) depot;
+
+error:
+
+    return 0;
+
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static void free_magazines(Magazine* magazine) {
+
+    while(0 != magazine) {
+
+        Magazine* next = magazine->next;
+
+        buffercache_free_buffers(magazine->items, magazine->num_items, 0);
+        free(magazine);
+        magazine = next;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* create_cache_func(BufferDepot* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferDepot* depot = (InternalBufferDepot*) self;
+
+    DepotCache* cache = calloc(1, sizeof(DepotCache));
+
+    if(0 == cache) goto error;
+
+    cache->depot = depot;
+    cache->loaded = magazine_create(depot->magazine_size);
+    cache->previous = magazine_create(depot->magazine_size);
+
+    if((0 == cache->loaded) || (0 == cache->previous)) {
+        free(cache->loaded);
+        free(cache->previous);
+        free(cache);
+        goto error;
+    }
+
+    cache->public = (Ringbuffer) {
+        .capacity = cache_capacity_func,
+        .add = cache_add_func,
+        .pop = cache_pop_func,
+        .add_n = cache_add_n_func,
+        .pop_n = cache_pop_n_func,
+        .pop_wait = cache_pop_wait_func,
+        .add_wait = cache_add_wait_func,
+        .resize = cache_resize_func,
+        .stats = cache_stats_func,
+        .latency = cache_latency_func,
+        .event_fd = cache_event_fd_func,
+        .free = cache_free_func,
+    };
+
+    return (Ringbuffer*) cache;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static BufferDepot* free_func(BufferDepot* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferDepot* depot = (InternalBufferDepot*) self;
+
+    free_magazines(depot->full);
+    free_magazines(depot->empty);
+
+    pthread_mutex_destroy(&depot->lock);
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Hand magazine over to the depot in exchange for one from list.
+ * @param list either &depot->full or &depot->empty
+ * @return the magazine received or 0 if list was empty
+ */
+static Magazine* exchange(
+        InternalBufferDepot* depot, Magazine* magazine, Magazine** list) {
+
+    pthread_mutex_lock(&depot->lock);
+
+    Magazine* received = *list;
+
+    if(0 != received) {
+
+        *list = received->next;
+        received->next = 0;
+
+        Magazine** other = (list == &depot->full) ? &depot->empty : &depot->full;
+
+        magazine->next = *other;
+        *other = magazine;
+
+    }
+
+    pthread_mutex_unlock(&depot->lock);
+
+    return received;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t cache_capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    return 2 * ((DepotCache*) self)->depot->magazine_size;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * If the cache and the depot are full, item is freed.
+ */
+static bool cache_add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    DepotCache* cache = (DepotCache*) self;
+    size_t magazine_size = cache->depot->magazine_size;
+
+    STATS_ADD(&cache->add_stats.adds, 1);
+
+    if(magazine_size == cache->loaded->num_items) {
+
+        Magazine* spare = cache->previous;
+
+        if(magazine_size == spare->num_items) {
+            spare = exchange(cache->depot, spare, &cache->depot->empty);
+        }
+
+        if(0 == spare) {
+            STATS_ADD(&cache->add_stats.overwrites, 1);
+            buffercache_free_buffers(&item, 1, 0);
+            return true;
+        }
+
+        cache->previous = cache->loaded;
+        cache->loaded = spare;
+
+    }
+
+    cache->loaded->items[cache->loaded->num_items++] = item;
+
+    STATS_WATERMARK(&cache->add_stats.high_watermark,
+            cache->loaded->num_items + cache->previous->num_items);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* cache_pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    DepotCache* cache = (DepotCache*) self;
+
+    if(0 == cache->loaded->num_items) {
+
+        Magazine* spare = cache->previous;
+
+        if(0 == spare->num_items) {
+            spare = exchange(cache->depot, spare, &cache->depot->full);
+        }
+
+        if(0 == spare) {
+            STATS_ADD(&cache->pop_stats.empty_pops, 1);
+            goto error;
+        }
+
+        cache->previous = cache->loaded;
+        cache->loaded = spare;
+
+    }
+
+    STATS_ADD(&cache->pop_stats.pops, 1);
+
+    return cache->loaded->items[--cache->loaded->num_items];
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t cache_add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    while((num_added < n) && cache_add_func(self, items[num_added])) {
+        ++num_added;
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t cache_pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == out) goto error;
+
+    size_t num_popped = 0;
+
+    while(num_popped < max) {
+
+        out[num_popped] = cache_pop_func(self);
+
+        if(0 == out[num_popped]) {
+            break;
+        }
+
+        ++num_popped;
+
+    }
+
+    return num_popped;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Only used by one thread, thus waiting is pointless.
+ */
+static void* cache_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return cache_pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool cache_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return cache_add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * The capacity is determined by the magazine size of the depot.
+ */
+static bool cache_resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A pop from the cache is a cache hit, an empty pop a cache miss.
+ * Buffer s freed because the depot was full count as overwrites.
+ */
+static bool cache_stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    DepotCache* cache = (DepotCache*) self;
+
+    stats_get(stats, &cache->add_stats, &cache->pop_stats,
+            cache->loaded->num_items + cache->previous->num_items);
+
+    stats->cache_hits = stats->pops;
+    stats->cache_misses = stats->empty_pops;
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool cache_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int cache_event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Non-empty magazines are exchanged for empty ones of the depot,
+ * whatever does not fit into the depot is freed.
+ */
+static Ringbuffer* cache_free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    DepotCache* cache = (DepotCache*) self;
+    Magazine* magazines[] = {cache->loaded, cache->previous};
+
+    for(size_t i = 0; i < 2; ++i) {
+
+        Magazine* magazine = magazines[i];
+
+        if(0 < magazine->num_items) {
+
+            Magazine* empty =
+                exchange(cache->depot, magazine, &cache->depot->empty);
+
+            magazine = (0 == empty) ? magazine : empty;
+
+        }
+
+        free_magazines(magazine);
+
+    }
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,241 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/buffer_drain.h"
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static ssize_t drain_func(BufferDrain* self, int fd);
+
+static size_t pending_func(BufferDrain* self);
+
+static BufferDrain* free_func(BufferDrain* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * buffers[0 .. num_buffers) have been popped, but not completely written.
+ * offset bytes of buffers[0] have been written already.
+ */
+typedef struct {
+
+    BufferDrain public;
+
+    Ringbuffer* ring;
+    Ringbuffer* cache;
+
+    size_t max_buffers;
+    size_t num_buffers;
+    size_t offset;
+
+    Buffer** buffers;
+    struct iovec* iov;
+
+} InternalBufferDrain;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+BufferDrain* buffer_drain_create(
+        Ringbuffer* ring, Ringbuffer* cache, size_t max_buffers) {
+
+    if(0 == ring) goto error;
+    if(0 == max_buffers) goto error;
+    if(IOV_MAX < max_buffers) goto error;
+
+    InternalBufferDrain* drain = calloc(1, sizeof(InternalBufferDrain));
+
+    if(0 == drain) goto error;
+
+    drain->buffers = calloc(max_buffers, sizeof(Buffer*));
+    drain->iov = calloc(max_buffers, sizeof(struct iovec));
+
+    if((0 == drain->buffers) || (0 == drain->iov)) {
+        free(drain->buffers);
+        free(drain->iov);
+        free(drain);
+        goto error;
+    }
+
+    drain->ring = ring;
+    drain->cache = cache;
+    drain->max_buffers = max_buffers;
+
+    drain->public = (BufferDrain) {
+        .drain = drain_func,
+        .pending = pending_func,
+        .free = free_func,
+    };
+
+    return (BufferDrain*) drain;
+
+error:
+
+    return 0;
+
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static ssize_t drain_func(BufferDrain* self, int fd) {
+
+    if(0 == self) goto error;
+
+    InternalBufferDrain* internal = (InternalBufferDrain*) self;
+    Ringbuffer* ring = internal->ring;
+
+    size_t num_buffers = internal->num_buffers;
+
+    if(num_buffers < internal->max_buffers) {
+
+        num_buffers += ring->pop_n(ring,
+                (void**) internal->buffers + num_buffers,
+                internal->max_buffers - num_buffers);
+
+    }
+
+    internal->num_buffers = num_buffers;
+
+    if(0 == num_buffers) {
+        return 0;
+    }
+
+    struct iovec* iov = internal->iov;
+    size_t offset = internal->offset;
+
+    for(size_t i = 0; i < num_buffers; ++i) {
+
+        Buffer* buffer = internal->buffers[i];
+
+        iov[i].iov_base = buffer->data + offset;
+        iov[i].iov_len = buffer->bytes_used - offset;
+        offset = 0;
+
+    }
+
+    ssize_t written = writev(fd, iov, num_buffers);
+
+    if(0 > written) goto error;
+
+    size_t remaining = written;
+    size_t num_done = 0;
+
+    while((num_done < num_buffers) && (iov[num_done].iov_len <= remaining)) {
+
+        remaining -= iov[num_done].iov_len;
+        buffercache_release_or_free_buffer(
+                internal->cache, internal->buffers[num_done]);
+        ++num_done;
+
+    }
+
+    if(0 < num_done) {
+
+        memmove(internal->buffers, internal->buffers + num_done,
+                (num_buffers - num_done) * sizeof(Buffer*));
+
+        internal->offset = 0;
+
+    }
+
+    internal->num_buffers = num_buffers - num_done;
+    internal->offset += remaining;
+
+    return written;
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pending_func(BufferDrain* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferDrain* internal = (InternalBufferDrain*) self;
+
+    size_t pending = 0;
+
+    for(size_t i = 0; i < internal->num_buffers; ++i) {
+        pending += internal->buffers[i]->bytes_used;
+    }
+
+    return pending - internal->offset;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static BufferDrain* free_func(BufferDrain* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferDrain* internal = (InternalBufferDrain*) self;
+
+    for(size_t i = 0; i < internal->num_buffers; ++i) {
+        buffercache_release_or_free_buffer(
+                internal->cache, internal->buffers[i]);
+    }
+
+    free(internal->buffers);
+    free(internal->iov);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,363 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/buffer_ingest.h"
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static ssize_t read_func(BufferIngest* self, int fd);
+
+static ssize_t receive_func(BufferIngest* self, int fd);
+
+static size_t pending_func(BufferIngest* self);
+
+static BufferIngest* free_func(BufferIngest* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * buffers[first_pending .. first_pending + num_pending) have been filled,
+ * but not added to ring yet.
+ */
+typedef struct {
+
+    BufferIngest public;
+
+    Ringbuffer* cache;
+    Ringbuffer* ring;
+
+    size_t max_buffers;
+    size_t buffer_size;
+
+    size_t first_pending;
+    size_t num_pending;
+
+    Buffer** buffers;
+    struct iovec* iov;
+    struct mmsghdr* messages;
+
+} InternalBufferIngest;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+BufferIngest* buffer_ingest_create(
+        Ringbuffer* cache,
+        Ringbuffer* ring,
+        size_t max_buffers,
+        size_t buffer_size) {
+
+    if(0 == ring) goto error;
+    if(0 == max_buffers) goto error;
+    if(IOV_MAX < max_buffers) goto error;
+    if(0 == buffer_size) goto error;
+
+    InternalBufferIngest* ingest = calloc(1, sizeof(InternalBufferIngest));
+
+    if(0 == ingest) goto error;
+
+    ingest->buffers = calloc(max_buffers, sizeof(Buffer*));
+    ingest->iov = calloc(max_buffers, sizeof(struct iovec));
+    ingest->messages = calloc(max_buffers, sizeof(struct mmsghdr));
+
+    if((0 == ingest->buffers) || (0 == ingest->iov) ||
+            (0 == ingest->messages)) {
+
+        free(ingest->buffers);
+        free(ingest->iov);
+        free(ingest->messages);
+        free(ingest);
+        goto error;
+
+    }
+
+    ingest->cache = cache;
+    ingest->ring = ring;
+    ingest->max_buffers = max_buffers;
+    ingest->buffer_size = buffer_size;
+
+    ingest->public = (BufferIngest) {
+        .read = read_func,
+        .receive = receive_func,
+        .pending = pending_func,
+        .free = free_func,
+    };
+
+    return (BufferIngest*) ingest;
+
+error:
+
+    return 0;
+
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+/**
+ * @return true if all pending buffers have been added to the ring
+ */
+static bool add_pending(InternalBufferIngest* internal) {
+
+    Ringbuffer* ring = internal->ring;
+
+    while(0 < internal->num_pending) {
+
+        size_t num_added = ring->add_n(ring,
+                (void**) internal->buffers + internal->first_pending,
+                internal->num_pending);
+
+        if(0 == num_added) {
+            return false;
+        }
+
+        internal->first_pending += num_added;
+        internal->num_pending -= num_added;
+
+    }
+
+    internal->first_pending = 0;
+
+    return true;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Takes up to max_buffers buffers from the cache, iov points to them.
+ * @return number of buffers taken
+ */
+static size_t get_buffers(InternalBufferIngest* internal) {
+
+    size_t num_buffers = 0;
+
+    for(; num_buffers < internal->max_buffers; ++num_buffers) {
+
+        Buffer* buffer =
+            buffercache_get_buffer(internal->cache, internal->buffer_size);
+
+        if(0 == buffer) {
+            break;
+        }
+
+        internal->buffers[num_buffers] = buffer;
+        internal->iov[num_buffers] = (struct iovec) {
+            .iov_base = buffer->data,
+            .iov_len = internal->buffer_size,
+        };
+
+    }
+
+    return num_buffers;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Releases the buffers that remained empty and adds the filled ones.
+ */
+static void add_filled(
+        InternalBufferIngest* internal, size_t num_filled, size_t num_buffers) {
+
+    for(size_t i = num_filled; i < num_buffers; ++i) {
+        buffercache_release_or_free_buffer(
+                internal->cache, internal->buffers[i]);
+    }
+
+    internal->first_pending = 0;
+    internal->num_pending = num_filled;
+
+    add_pending(internal);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static ssize_t read_func(BufferIngest* self, int fd) {
+
+    if(0 == self) goto error;
+
+    InternalBufferIngest* internal = (InternalBufferIngest*) self;
+
+    if(! add_pending(internal)) {
+        errno = ENOBUFS;
+        goto error;
+    }
+
+    size_t num_buffers = get_buffers(internal);
+
+    if(0 == num_buffers) goto error;
+
+    ssize_t num_read = readv(fd, internal->iov, num_buffers);
+    int readv_errno = errno;
+
+    size_t num_filled = 0;
+
+    for(size_t left = (0 < num_read) ? num_read : 0; 0 < left; ++num_filled) {
+
+        size_t bytes_used =
+            (left < internal->buffer_size) ? left : internal->buffer_size;
+
+        internal->buffers[num_filled]->bytes_used = bytes_used;
+        left -= bytes_used;
+
+    }
+
+    add_filled(internal, num_filled, num_buffers);
+
+    errno = readv_errno;
+
+    return num_read;
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static ssize_t receive_func(BufferIngest* self, int fd) {
+
+    if(0 == self) goto error;
+
+    InternalBufferIngest* internal = (InternalBufferIngest*) self;
+
+    if(! add_pending(internal)) {
+        errno = ENOBUFS;
+        goto error;
+    }
+
+    size_t num_buffers = get_buffers(internal);
+
+    if(0 == num_buffers) goto error;
+
+    struct mmsghdr* messages = internal->messages;
+
+    for(size_t i = 0; i < num_buffers; ++i) {
+
+        messages[i] = (struct mmsghdr) {
+            .msg_hdr = {
+                .msg_iov = internal->iov + i,
+                .msg_iovlen = 1,
+            },
+        };
+
+    }
+
+    int num_received =
+        recvmmsg(fd, messages, num_buffers, MSG_WAITFORONE, 0);
+    int recvmmsg_errno = errno;
+
+    size_t num_filled = (0 < num_received) ? num_received : 0;
+
+    for(size_t i = 0; i < num_filled; ++i) {
+
+        size_t bytes_used = messages[i].msg_len;
+
+        internal->buffers[i]->bytes_used =
+            (bytes_used < internal->buffer_size) ?
+            bytes_used : internal->buffer_size;
+
+    }
+
+    add_filled(internal, num_filled, num_buffers);
+
+    errno = recvmmsg_errno;
+
+    return num_received;
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pending_func(BufferIngest* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferIngest* internal = (InternalBufferIngest*) self;
+
+    return internal->num_pending;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static BufferIngest* free_func(BufferIngest* self) {
+
+    if(0 == self) goto error;
+
+    InternalBufferIngest* internal = (InternalBufferIngest*) self;
+
+    for(size_t i = 0; i < internal->num_pending; ++i) {
+        buffercache_release_or_free_buffer(internal->cache,
+                internal->buffers[internal->first_pending + i]);
+    }
+
+    free(internal->buffers);
+    free(internal->iov);
+    free(internal->messages);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -33,6 +33,15 @@
  */
 #include "../include/ringbuffer.h"
 #include "../include/buffercache.h"
+#include "stats.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
 
 /******************************************************************************
                                PRIVATE PROTOTYPES
@@ -40,6 +49,218 @@
 
 static void buffer_free(void* data_buffer, void* arg);
 
+static bool buffer_unref(Buffer* buffer);
+
+static Ringbuffer* cache_free_func(Ringbuffer* self);
+
+/*----------------------------------------------------------------------------*/
+
+static size_t classes_capacity_func(Ringbuffer* self);
+
+static bool classes_add_func(Ringbuffer* self, void* item);
+
+static void* classes_pop_func(Ringbuffer* self);
+
+static size_t classes_add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t classes_pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* classes_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool classes_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool classes_resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool classes_stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool classes_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int classes_event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* classes_free_func(Ringbuffer* self);
+
+/*----------------------------------------------------------------------------*/
+
+static size_t slabs_capacity_func(Ringbuffer* self);
+
+static bool slabs_add_func(Ringbuffer* self, void* item);
+
+static void* slabs_pop_func(Ringbuffer* self);
+
+static size_t slabs_add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t slabs_pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* slabs_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool slabs_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool slabs_resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool slabs_stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool slabs_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int slabs_event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* slabs_free_func(Ringbuffer* self);
+
+/*----------------------------------------------------------------------------*/
+
+static size_t inbox_capacity_func(Ringbuffer* self);
+
+static bool inbox_add_func(Ringbuffer* self, void* item);
+
+static void* inbox_pop_func(Ringbuffer* self);
+
+static size_t inbox_add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t inbox_pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* inbox_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool inbox_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool inbox_resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool inbox_stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool inbox_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int inbox_event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* inbox_free_func(Ringbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * Common header of all caches implemented here.
+ * buffercache_get_buffer dispatches to get_buffer.
+ * All of them use cache_free_func as free, which identifies them and
+ * dispatches to free_cache.
+ */
+typedef struct InternalCache {
+
+    Ringbuffer public;
+
+    Buffer* (*get_buffer)(struct InternalCache* self, size_t min_length_bytes);
+    Ringbuffer* (*free_cache)(Ringbuffer* self);
+
+    /* Cache this one forwards to, 0 if none */
+    Ringbuffer* wrapped;
+
+} InternalCache;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * classes[i] holds Buffer s with a capacity of at least
+ * 2^(min_shift + i) bytes.
+ */
+typedef struct {
+
+    InternalCache internal;
+
+    size_t min_shift;
+    size_t num_classes;
+
+    Ringbuffer* classes[];
+
+} ClassedCache;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A Buffer carved out of a slab: Header and payload share one block,
+ * data points to payload.
+ */
+typedef struct {
+
+    Buffer buffer;
+    uint8_t payload[];
+
+} SlabBuffer;
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct Slab {
+
+    struct Slab* next;
+
+    /* num_buffers_per_slab blocks of block_size bytes each */
+    alignas(CACHE_LINE_SIZE) uint8_t blocks[];
+
+} Slab;
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    InternalCache internal;
+
+    size_t buffer_size;
+    size_t block_size;
+    size_t num_buffers_per_slab;
+
+    /* Most recent slab first, blocks are carved from the most recent one */
+    Slab* slabs;
+    size_t num_slabs;
+    size_t num_carved;
+
+    /* Released Buffer s, linked via Buffer.next.
+     * Each carved Buffer is either handed out or in here, thus this list
+     * never holds more than num_slabs * num_buffers_per_slab Buffer s and
+     * releasing neither fails nor allocates */
+    Buffer* released;
+    size_t num_released;
+
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+    PopStats pop_stats;
+#endif
+
+} SlabCache;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Remote threads push onto inbox, linked via Buffer.next.
+ * The owning thread only ever takes the inbox as a whole,
+ * thus there is no ABA problem.
+ */
+typedef struct {
+
+    InternalCache internal;
+
+    Ringbuffer* cache;
+
+    alignas(CACHE_LINE_SIZE) _Atomic(Buffer*) inbox;
+
+} InboxCache;
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* classes_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes);
+
+static Buffer* slabs_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes);
+
+static Buffer* inbox_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes);
+
+static void inbox_collect(InboxCache* cache);
+
+static void inbox_push(InboxCache* cache, Buffer* buffer);
+
 /******************************************************************************
                                PUBLIC FUNCTIONS
  ******************************************************************************/
@@ -52,7 +273,238 @@ Ringbuffer* buffercache_create(size_t capacity) {
 
 /*----------------------------------------------------------------------------*/
 
-Buffer* buffercache_get_buffer(Ringbuffer* cache, size_t min_length_bytes) {
+Ringbuffer* buffercache_create_with_reclaimer(
+        size_t capacity, Reclaimer* reclaimer) {
+
+    if(0 == reclaimer) goto error;
+
+    return ringbuffer_create(capacity, reclaimer_free_item, reclaimer);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t floor_log2(size_t n) {
+
+    return 8 * sizeof(unsigned long long) - 1 - __builtin_clzll(n);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t ceil_log2(size_t n) {
+
+    return (1 >= n) ? 0 : 1 + floor_log2(n - 1);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* buffercache_create_with_classes(
+        size_t min_size_bytes,
+        size_t max_size_bytes,
+        size_t capacity_per_class) {
+
+    if(0 == min_size_bytes) goto error;
+    if(max_size_bytes < min_size_bytes) goto error;
+    if(0 == capacity_per_class) goto error;
+
+    size_t min_shift = ceil_log2(min_size_bytes);
+    size_t max_shift = floor_log2(max_size_bytes);
+
+    /* No power of two in between */
+    if(max_shift < min_shift) goto error;
+
+    size_t num_classes = max_shift - min_shift + 1;
+
+    ClassedCache* cache =
+        calloc(1, sizeof(ClassedCache) + num_classes * sizeof(Ringbuffer*));
+
+    if(0 == cache) goto error;
+
+    cache->min_shift = min_shift;
+    cache->num_classes = num_classes;
+
+    cache->internal.public = (Ringbuffer) {
+        .capacity = classes_capacity_func,
+        .add = classes_add_func,
+        .pop = classes_pop_func,
+        .add_n = classes_add_n_func,
+        .pop_n = classes_pop_n_func,
+        .pop_wait = classes_pop_wait_func,
+        .add_wait = classes_add_wait_func,
+        .resize = classes_resize_func,
+        .stats = classes_stats_func,
+        .latency = classes_latency_func,
+        .event_fd = classes_event_fd_func,
+        .free = cache_free_func,
+    };
+
+    cache->internal.get_buffer = classes_get_buffer_func;
+    cache->internal.free_cache = classes_free_func;
+
+    for(size_t i = 0; i < num_classes; ++i) {
+
+        cache->classes[i] = ringbuffer_create(capacity_per_class, buffer_free, 0);
+
+        if(0 == cache->classes[i]) {
+            classes_free_func((Ringbuffer*) cache);
+            goto error;
+        }
+
+    }
+
+    return (Ringbuffer*) cache;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* buffercache_create_with_slabs(
+        size_t buffer_size_bytes, size_t num_buffers_per_slab) {
+
+    if(0 == buffer_size_bytes) goto error;
+    if(0 == num_buffers_per_slab) goto error;
+
+    SlabCache* cache = calloc(1, sizeof(SlabCache));
+
+    if(0 == cache) goto error;
+
+    size_t block_size = sizeof(SlabBuffer) + buffer_size_bytes;
+
+    cache->buffer_size = buffer_size_bytes;
+    cache->block_size =
+        (block_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    cache->num_buffers_per_slab = num_buffers_per_slab;
+
+    cache->internal.public = (Ringbuffer) {
+        .capacity = slabs_capacity_func,
+        .add = slabs_add_func,
+        .pop = slabs_pop_func,
+        .add_n = slabs_add_n_func,
+        .pop_n = slabs_pop_n_func,
+        .pop_wait = slabs_pop_wait_func,
+        .add_wait = slabs_add_wait_func,
+        .resize = slabs_resize_func,
+        .stats = slabs_stats_func,
+        .latency = slabs_latency_func,
+        .event_fd = slabs_event_fd_func,
+        .free = cache_free_func,
+    };
+
+    cache->internal.get_buffer = slabs_get_buffer_func;
+    cache->internal.free_cache = slabs_free_func;
+
+    return (Ringbuffer*) cache;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* buffercache_create_with_inbox(Ringbuffer* cache) {
+
+    if(0 == cache) goto error;
+
+    InboxCache* inbox_cache =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InboxCache));
+
+    if(0 == inbox_cache) goto error;
+
+    memset(inbox_cache, 0, sizeof(InboxCache));
+
+    inbox_cache->cache = cache;
+    atomic_init(&inbox_cache->inbox, 0);
+
+    inbox_cache->internal.public = (Ringbuffer) {
+        .capacity = inbox_capacity_func,
+        .add = inbox_add_func,
+        .pop = inbox_pop_func,
+        .add_n = inbox_add_n_func,
+        .pop_n = inbox_pop_n_func,
+        .pop_wait = inbox_pop_wait_func,
+        .add_wait = inbox_add_wait_func,
+        .resize = inbox_resize_func,
+        .stats = inbox_stats_func,
+        .latency = inbox_latency_func,
+        .event_fd = inbox_event_fd_func,
+        .free = cache_free_func,
+    };
+
+    inbox_cache->internal.get_buffer = inbox_get_buffer_func;
+    inbox_cache->internal.free_cache = inbox_free_func;
+    inbox_cache->internal.wrapped = cache;
+
+    return (Ringbuffer*) inbox_cache;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+bool buffercache_release_buffer_remote(Ringbuffer* cache, Buffer* buffer) {
+
+    if(0 == buffer) goto error;
+
+    if(0 != buffer->owner) {
+        cache = buffer->owner;
+    }
+
+    if(0 == cache) goto error;
+    if(inbox_add_func != cache->add) goto error;
+
+    if(! buffer_unref(buffer)) {
+        return true;
+    }
+
+    inbox_push((InboxCache*) cache, buffer);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void buffercache_free_buffers(void** buffers, size_t n, void* additional_arg) {
+
+    if(0 == buffers) goto error;
+
+    for(size_t i = 0; i < n; ++i) {
+        buffer_free(buffers[i], additional_arg);
+    }
+
+error:
+
+    return;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* get_buffer(Ringbuffer* cache, size_t min_length_bytes) {
+
+    if((0 != cache) && (cache_free_func == cache->free)) {
+        InternalCache* internal = (InternalCache*) cache;
+        return internal->get_buffer(internal, min_length_bytes);
+    }
 
     Buffer* db =  0;
 
@@ -64,6 +516,8 @@ Buffer* buffercache_get_buffer(Ringbuffer* cache, size_t min_length_bytes) {
         db = calloc(1, sizeof(Buffer));
     }
 
+    if(0 == db) goto error;
+
     if(db->capacity_bytes < min_length_bytes) {
         if(0 != db->data) {
             free(db->data);
@@ -72,23 +526,75 @@ Buffer* buffercache_get_buffer(Ringbuffer* cache, size_t min_length_bytes) {
     }
 
     if(0 == db->data) {
-        db->data = calloc(1, sizeof(min_length_bytes) * sizeof(uint8_t));
+        db->data = calloc(1, min_length_bytes * sizeof(uint8_t));
         db->capacity_bytes = min_length_bytes;
     }
 
+    if((0 == db->data) && (0 < min_length_bytes)) {
+        free(db);
+        goto error;
+    }
+
     db->bytes_used = 0;
 
     return db;
 
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Buffer* buffercache_get_buffer(Ringbuffer* cache, size_t min_length_bytes) {
+
+    Buffer* buffer = get_buffer(cache, min_length_bytes);
+
+    if(0 != buffer) {
+        atomic_store_explicit(&buffer->refs, 1, memory_order_relaxed);
+    }
+
+    return buffer;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Buffer* buffercache_retain_buffer(Buffer* buffer) {
+
+    if(0 == buffer) goto error;
+
+    /* A Buffer not counted yet has a single reference */
+    if(0 == atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed);
+    }
+
+    return buffer;
+
+error:
+
+    return 0;
+
 }
 
 /*----------------------------------------------------------------------------*/
 
 bool buffercache_release_buffer(Ringbuffer* cache, Buffer* buffer) {
 
-    if(0 == cache) goto finish;
     if(0 == buffer) goto finish;
-    
+
+    /* Owned Buffer s must go back where they came from */
+    if(0 != buffer->owner) {
+        cache = buffer->owner;
+    }
+
+    if(0 == cache) goto finish;
+
+    if(! buffer_unref(buffer)) {
+        return true;
+    }
+
     buffer->bytes_used = 0;
 
     return cache->add(cache, buffer);
@@ -101,6 +607,25 @@ finish:
 
 /*----------------------------------------------------------------------------*/
 
+void buffercache_release_or_free_buffer(Ringbuffer* cache, Buffer* buffer) {
+
+    if(! buffercache_release_buffer(cache, buffer)) {
+        buffer_free(buffer, 0);
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Drops one reference to buffer. The last one hands an owned Buffer back to
+ * its owner and frees any other Buffer.
+ * Owned Buffer s are never freed here, they might be part of a larger
+ * allocation. If their owner refuses them, they are dropped and reclaimed
+ * together with their owner.
+ * Might run on any thread, e.g. in a Reclaimer, thus an owner with an inbox
+ * gets the Buffer via its inbox.
+ */
 static void buffer_free(void* buffer, void* additional_arg) {
 
     // UNUSED(additional_arg);
@@ -109,6 +634,22 @@ static void buffer_free(void* buffer, void* additional_arg) {
 
     Buffer* db = buffer;
 
+    if(! buffer_unref(db)) goto error;
+
+    if(0 != db->owner) {
+
+        db->bytes_used = 0;
+
+        if(inbox_add_func == db->owner->add) {
+            inbox_push((InboxCache*) db->owner, db);
+        } else {
+            db->owner->add(db->owner, db);
+        }
+
+        goto error;
+
+    }
+
     if(0 != db->data) {
         free(db->data);
         db->data = 0;
@@ -123,3 +664,982 @@ error:
 }
 
 /*----------------------------------------------------------------------------*/
+
+/**
+ * Drops one reference to buffer.
+ * @return true if this was the last reference
+ */
+static bool buffer_unref(Buffer* buffer) {
+
+    /* Nobody else might retain a Buffer we hold the only reference to */
+    if(1 >= atomic_load_explicit(&buffer->refs, memory_order_acquire)) {
+        atomic_store_explicit(&buffer->refs, 0, memory_order_relaxed);
+        return true;
+    }
+
+    return 1 == atomic_fetch_sub_explicit(
+            &buffer->refs, 1, memory_order_acq_rel);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* buffer_allocate(size_t capacity_bytes) {
+
+    Buffer* buffer = calloc(1, sizeof(Buffer));
+
+    if(0 == buffer) goto error;
+
+    buffer->data = calloc(1, capacity_bytes * sizeof(uint8_t));
+
+    if(0 == buffer->data) {
+        free(buffer);
+        goto error;
+    }
+
+    buffer->capacity_bytes = capacity_bytes;
+
+    return buffer;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* cache_free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    return ((InternalCache*) self)->free_cache(self);
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return true if buffer is owned by cache or by a cache wrapping it
+ */
+static bool is_owned_by(Buffer* buffer, Ringbuffer* cache) {
+
+    Ringbuffer* owner = buffer->owner;
+
+    while((0 != owner) && (cache != owner)) {
+        owner = (cache_free_func == owner->free) ?
+            ((InternalCache*) owner)->wrapped : 0;
+    }
+
+    return 0 != owner;
+
+}
+
+/******************************************************************************
+                                SIZE CLASSES
+ ******************************************************************************/
+
+/**
+ * @return index of the smallest class that holds Buffer s of size bytes,
+ *         num_classes or more if there is none
+ */
+static size_t class_for_request(ClassedCache* cache, size_t size) {
+
+    size_t shift = ceil_log2(size);
+
+    return (shift < cache->min_shift) ? 0 : shift - cache->min_shift;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return index of the largest class a Buffer of capacity bytes fits,
+ *         num_classes or more if there is none
+ */
+static size_t class_for_buffer(ClassedCache* cache, size_t capacity) {
+
+    if(capacity < ((size_t) 1 << cache->min_shift)) {
+        return cache->num_classes;
+    }
+
+    return floor_log2(capacity) - cache->min_shift;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * On a miss, the Buffer is allocated with the size of its class to be
+ * reused for all requests of this class later on.
+ */
+static Buffer* classes_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes) {
+
+    ClassedCache* cache = (ClassedCache*) self;
+    size_t index = class_for_request(cache, min_length_bytes);
+    size_t capacity_bytes = min_length_bytes;
+
+    if(index < cache->num_classes) {
+
+        Ringbuffer* class = cache->classes[index];
+        Buffer* buffer = class->pop(class);
+
+        if(0 != buffer) {
+            buffer->bytes_used = 0;
+            return buffer;
+        }
+
+        capacity_bytes = (size_t) 1 << (cache->min_shift + index);
+
+    }
+
+    return buffer_allocate(capacity_bytes);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t classes_capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+    Ringbuffer* class = cache->classes[0];
+
+    return cache->num_classes * class->capacity(class);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Buffer s that do not fit any class are freed right away.
+ */
+static bool classes_add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+    Buffer* buffer = item;
+
+    size_t index = class_for_buffer(cache, buffer->capacity_bytes);
+
+    if(index >= cache->num_classes) {
+        buffer_free(buffer, 0);
+        return true;
+    }
+
+    Ringbuffer* class = cache->classes[index];
+
+    return class->add(class, buffer);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* classes_pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+
+    for(size_t i = 0; i < cache->num_classes; ++i) {
+
+        Ringbuffer* class = cache->classes[i];
+        void* item = class->pop(class);
+
+        if(0 != item) {
+            return item;
+        }
+
+    }
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t classes_add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    while((num_added < n) && classes_add_func(self, items[num_added])) {
+        ++num_added;
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t classes_pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == out) goto error;
+
+    size_t num_popped = 0;
+
+    while(num_popped < max) {
+
+        out[num_popped] = classes_pop_func(self);
+
+        if(0 == out[num_popped]) {
+            break;
+        }
+
+        ++num_popped;
+
+    }
+
+    return num_popped;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Not thread-safe, thus waiting is pointless.
+ */
+static void* classes_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return classes_pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool classes_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return classes_add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * new_capacity is split evenly among the classes.
+ */
+static bool classes_resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+    if(0 == new_capacity) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+
+    size_t capacity_per_class =
+        (new_capacity + cache->num_classes - 1) / cache->num_classes;
+
+    for(size_t i = 0; i < cache->num_classes; ++i) {
+
+        Ringbuffer* class = cache->classes[i];
+
+        if(! class->resize(class, capacity_per_class)) goto error;
+
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Sums up the statistics of all classes.
+ * A pop from a class is a cache hit, an empty pop a cache miss.
+ * high_watermark is the sum of the high watermarks of the classes.
+ */
+static bool classes_stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+
+    memset(stats, 0, sizeof(RingbufferStats));
+
+    for(size_t i = 0; i < cache->num_classes; ++i) {
+
+        Ringbuffer* class = cache->classes[i];
+        RingbufferStats class_stats;
+
+        if(! class->stats(class, &class_stats)) goto error;
+
+        stats->adds += class_stats.adds;
+        stats->pops += class_stats.pops;
+        stats->empty_pops += class_stats.empty_pops;
+        stats->overwrites += class_stats.overwrites;
+        stats->num_items += class_stats.num_items;
+        stats->high_watermark += class_stats.high_watermark;
+        stats->cache_hits += class_stats.pops;
+        stats->cache_misses += class_stats.empty_pops;
+
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool classes_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int classes_event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* classes_free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    ClassedCache* cache = (ClassedCache*) self;
+
+    for(size_t i = 0; i < cache->num_classes; ++i) {
+
+        Ringbuffer* class = cache->classes[i];
+
+        if(0 != class) {
+            class->free(class);
+        }
+
+    }
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/******************************************************************************
+                                    SLABS
+ ******************************************************************************/
+
+static SlabBuffer* slab_carve(SlabCache* cache) {
+
+    if((0 == cache->slabs) ||
+       (cache->num_carved == cache->num_buffers_per_slab)) {
+
+        Slab* slab = aligned_alloc(CACHE_LINE_SIZE,
+                sizeof(Slab) + cache->num_buffers_per_slab * cache->block_size);
+
+        if(0 == slab) goto error;
+
+        slab->next = cache->slabs;
+        cache->slabs = slab;
+        cache->num_carved = 0;
+        ++cache->num_slabs;
+
+    }
+
+    SlabBuffer* block = (SlabBuffer*)
+        (cache->slabs->blocks + cache->num_carved * cache->block_size);
+
+    ++cache->num_carved;
+
+    block->buffer = (Buffer) {
+        .capacity_bytes = cache->buffer_size,
+        .data = block->payload,
+        .owner = &cache->internal.public,
+    };
+
+    return block;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* slab_pop_released(SlabCache* cache) {
+
+    Buffer* buffer = cache->released;
+
+    if(0 == buffer) {
+        STATS_ADD(&cache->pop_stats.empty_pops, 1);
+        return 0;
+    }
+
+    cache->released = buffer->next;
+    buffer->next = 0;
+    --cache->num_released;
+
+    STATS_ADD(&cache->pop_stats.pops, 1);
+
+    return buffer;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool is_slab_buffer(SlabCache* cache, Buffer* buffer) {
+
+    return is_owned_by(buffer, &cache->internal.public) &&
+           (((SlabBuffer*) buffer)->payload == buffer->data);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* slabs_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes) {
+
+    SlabCache* cache = (SlabCache*) self;
+
+    if(min_length_bytes > cache->buffer_size) {
+        return buffer_allocate(min_length_bytes);
+    }
+
+    SlabBuffer* block = (SlabBuffer*) slab_pop_released(cache);
+
+    if(0 == block) {
+        block = slab_carve(cache);
+    }
+
+    if(0 == block) goto error;
+
+    block->buffer.owner = &self->public;
+    block->buffer.bytes_used = 0;
+
+    return &block->buffer;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t slabs_capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    SlabCache* cache = (SlabCache*) self;
+
+    return cache->num_slabs * cache->num_buffers_per_slab;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Buffer s that were not carved from one of our slabs are freed right away,
+ * or handed to their owner.
+ */
+static bool slabs_add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    SlabCache* cache = (SlabCache*) self;
+
+    if(! is_slab_buffer(cache, item)) {
+
+        /* buffer_free would hand it right back */
+        if(is_owned_by(item, self)) goto error;
+
+        buffer_free(item, 0);
+        return true;
+
+    }
+
+    Buffer* buffer = item;
+
+    buffer->next = cache->released;
+    cache->released = buffer;
+    ++cache->num_released;
+
+    STATS_ADD(&cache->add_stats.adds, 1);
+    STATS_WATERMARK(&cache->add_stats.high_watermark, cache->num_released);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* slabs_pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    return slab_pop_released((SlabCache*) self);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t slabs_add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    while((num_added < n) && slabs_add_func(self, items[num_added])) {
+        ++num_added;
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t slabs_pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+    if(0 == out) goto error;
+
+    SlabCache* cache = (SlabCache*) self;
+
+    size_t num_popped = 0;
+
+    while((num_popped < max) && (0 != cache->released)) {
+        out[num_popped++] = slab_pop_released(cache);
+    }
+
+    return num_popped;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Not thread-safe, thus waiting is pointless.
+ */
+static void* slabs_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return slabs_pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool slabs_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return slabs_add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * The capacity always suffices to hold all Buffer s carved so far,
+ * it cannot be changed.
+ */
+static bool slabs_resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * A pop from the released Buffer s is a cache hit, an empty pop a cache miss.
+ */
+static bool slabs_stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    SlabCache* cache = (SlabCache*) self;
+
+    stats_get(stats, &cache->add_stats, &cache->pop_stats,
+            cache->num_released);
+
+    stats->cache_hits = stats->pops;
+    stats->cache_misses = stats->empty_pops;
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool slabs_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int slabs_event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Releases whole slabs, thus all Buffer s carved from them become invalid,
+ * regardless of whether they had been released before.
+ */
+static Ringbuffer* slabs_free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    SlabCache* cache = (SlabCache*) self;
+
+    Slab* slab = cache->slabs;
+
+    while(0 != slab) {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/******************************************************************************
+                                    INBOX
+ ******************************************************************************/
+
+/**
+ * Moves all remotely released Buffer s into the wrapped cache.
+ */
+static void inbox_collect(InboxCache* cache) {
+
+    /* Avoid the exchange on the common path */
+    if(0 == atomic_load_explicit(&cache->inbox, memory_order_relaxed)) {
+        return;
+    }
+
+    Buffer* buffer =
+        atomic_exchange_explicit(&cache->inbox, 0, memory_order_acquire);
+
+    while(0 != buffer) {
+
+        Buffer* next = buffer->next;
+        buffer->next = 0;
+        buffer->bytes_used = 0;
+
+        /* buffer_free would push an owned Buffer right back */
+        if((! cache->cache->add(cache->cache, buffer)) &&
+           (0 == buffer->owner)) {
+            buffer_free(buffer, 0);
+        }
+
+        buffer = next;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Thread-safe, might be called by any number of threads at once.
+ */
+static void inbox_push(InboxCache* cache, Buffer* buffer) {
+
+    Buffer* head = atomic_load_explicit(&cache->inbox, memory_order_relaxed);
+
+    do {
+
+        buffer->next = head;
+
+    } while(! atomic_compare_exchange_weak_explicit(
+                &cache->inbox, &head, buffer,
+                memory_order_release, memory_order_relaxed));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Buffer* inbox_get_buffer_func(
+        InternalCache* self, size_t min_length_bytes) {
+
+    InboxCache* cache = (InboxCache*) self;
+
+    inbox_collect(cache);
+
+    Buffer* buffer = get_buffer(cache->cache, min_length_bytes);
+
+    /* Remote releases of owned Buffer s have to find our inbox */
+    if((0 != buffer) && (0 != buffer->owner)) {
+        buffer->owner = &self->public;
+    }
+
+    return buffer;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t inbox_capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->capacity(cache);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool inbox_add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->add(cache, item);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* inbox_pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    inbox_collect((InboxCache*) self);
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->pop(cache);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t inbox_add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->add_n(cache, items, n);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t inbox_pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+
+    inbox_collect((InboxCache*) self);
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->pop_n(cache, out, max);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Remote releases do not wake up the owning thread, thus waiting is
+ * pointless.
+ */
+static void* inbox_pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return inbox_pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool inbox_add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return inbox_add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool inbox_resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->resize(cache, new_capacity);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Statistics of the wrapped cache.
+ */
+static bool inbox_stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+
+    Ringbuffer* cache = ((InboxCache*) self)->cache;
+
+    return cache->stats(cache, stats);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool inbox_latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int inbox_event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Must not be called while other threads might still release Buffer s
+ * remotely.
+ */
+static Ringbuffer* inbox_free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InboxCache* cache = (InboxCache*) self;
+
+    inbox_collect(cache);
+
+    cache->cache = cache->cache->free(cache->cache);
+
+    if(0 != cache->cache) goto error;
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
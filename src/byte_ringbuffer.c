@@ -0,0 +1,386 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/byte_ringbuffer.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/* Every record is preceded by its length and starts RECORD_ALIGNMENT aligned */
+#define RECORD_HEADER_BYTES sizeof(size_t)
+#define RECORD_ALIGNMENT sizeof(size_t)
+
+/* Length of a record that just fills up the end of the memory */
+#define PADDING_MARKER SIZE_MAX
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(ByteRingbuffer* self);
+
+static uint8_t* reserve_func(ByteRingbuffer* self, size_t length);
+
+static bool commit_func(ByteRingbuffer* self, size_t length);
+
+static uint8_t* peek_func(ByteRingbuffer* self, size_t* length);
+
+static bool release_func(ByteRingbuffer* self);
+
+static ByteRingbuffer* free_func(ByteRingbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * next_to_write and next_to_read are byte positions that are never wrapped,
+ * the offset into memory is determined by masking with index_mask.
+ *
+ * A record never wraps around the end of memory. If it does not fit,
+ * the remainder of memory is skipped by a padding record.
+ */
+typedef struct InternalByteRingbuffer {
+
+    ByteRingbuffer public;
+
+    size_t capacity_bytes;
+    size_t index_mask;
+    uint8_t* memory;
+
+    /* Used by producer only */
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_write;
+    size_t cached_next_to_read;
+    size_t reserved_position;
+    size_t reserved_length;
+    bool reserved;
+
+    /* Used by consumer only */
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_read;
+    size_t cached_next_to_write;
+
+} InternalByteRingbuffer;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+ByteRingbuffer* byte_ringbuffer_create(size_t capacity_bytes) {
+
+    if(0 >= capacity_bytes) {
+        goto error;
+    }
+
+    size_t num_bytes = CACHE_LINE_SIZE;
+
+    while(num_bytes < capacity_bytes) {
+        num_bytes <<= 1;
+    }
+
+    InternalByteRingbuffer* buffer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalByteRingbuffer));
+
+    if(0 == buffer) goto error;
+
+    memset(buffer, 0, sizeof(InternalByteRingbuffer));
+
+    buffer->memory = aligned_alloc(CACHE_LINE_SIZE, num_bytes);
+
+    if(0 == buffer->memory) {
+        free(buffer);
+        goto error;
+    }
+
+    buffer->capacity_bytes = num_bytes;
+    buffer->index_mask = num_bytes - 1;
+
+    atomic_init(&buffer->next_to_write, 0);
+    atomic_init(&buffer->next_to_read, 0);
+
+    buffer->public = (ByteRingbuffer) {
+        .capacity = capacity_func,
+        .reserve = reserve_func,
+        .commit = commit_func,
+        .peek = peek_func,
+        .release = release_func,
+        .free = free_func,
+    };
+
+    return (ByteRingbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static inline size_t record_bytes(size_t length) {
+
+    return RECORD_HEADER_BYTES +
+        ((length + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline size_t* header_at(
+        InternalByteRingbuffer* internal, size_t position) {
+
+    return (size_t*) (internal->memory + (position & internal->index_mask));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Skips a padding record if necessary.
+ * @return header of the oldest record or 0 if the ringbuffer is empty
+ */
+static size_t* oldest_header(InternalByteRingbuffer* internal) {
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    if(read == internal->cached_next_to_write) {
+
+        internal->cached_next_to_write = atomic_load_explicit(
+                &internal->next_to_write, memory_order_acquire);
+
+        if(read == internal->cached_next_to_write) {
+            goto error;
+        }
+
+    }
+
+    size_t* header = header_at(internal, read);
+
+    if(PADDING_MARKER == *header) {
+
+        /* A padding record is always committed along with a real record */
+        read += internal->capacity_bytes - (read & internal->index_mask);
+
+        atomic_store_explicit(
+                &internal->next_to_read, read, memory_order_release);
+
+        header = header_at(internal, read);
+
+    }
+
+    return header;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t capacity_func(ByteRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+
+    return internal->capacity_bytes;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static uint8_t* reserve_func(ByteRingbuffer* self, size_t length) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+    const size_t capacity = internal->capacity_bytes;
+
+    internal->reserved = false;
+
+    if(length >= capacity) goto error;
+
+    const size_t required = record_bytes(length);
+
+    /* A larger record might not fit before a padding marker written at
+     * the current offset, even into an empty ringbuffer */
+    if(required > capacity / 2) goto error;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    size_t offset = write & internal->index_mask;
+    size_t padding = 0;
+
+    if(capacity - offset < required) {
+        padding = capacity - offset;
+    }
+
+    if(capacity - (write - internal->cached_next_to_read) <
+            padding + required) {
+
+        internal->cached_next_to_read = atomic_load_explicit(
+                &internal->next_to_read, memory_order_acquire);
+
+        if(capacity - (write - internal->cached_next_to_read) <
+                padding + required) {
+            goto error;
+        }
+
+    }
+
+    if(0 != padding) {
+        *header_at(internal, write) = PADDING_MARKER;
+        offset = 0;
+    }
+
+    internal->reserved_position = write + padding;
+    internal->reserved_length = length;
+    internal->reserved = true;
+
+    return internal->memory + offset + RECORD_HEADER_BYTES;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool commit_func(ByteRingbuffer* self, size_t length) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+
+    if(! internal->reserved) goto error;
+    if(length > internal->reserved_length) goto error;
+
+    size_t position = internal->reserved_position;
+
+    *header_at(internal, position) = length;
+    internal->reserved = false;
+
+    atomic_store_explicit(&internal->next_to_write,
+            position + record_bytes(length), memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static uint8_t* peek_func(ByteRingbuffer* self, size_t* length) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+
+    size_t* header = oldest_header(internal);
+
+    if(0 == header) goto error;
+
+    if(0 != length) {
+        *length = *header;
+    }
+
+    return ((uint8_t*) header) + RECORD_HEADER_BYTES;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool release_func(ByteRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+
+    size_t* header = oldest_header(internal);
+
+    if(0 == header) goto error;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    atomic_store_explicit(&internal->next_to_read,
+            read + record_bytes(*header), memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static ByteRingbuffer* free_func(ByteRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalByteRingbuffer* internal = (InternalByteRingbuffer*) self;
+
+    free(internal->memory);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -60,6 +60,16 @@ typedef struct InternalRingbuffer {
 static size_t capacity_func(Ringbuffer* self);
 static bool add_func(Ringbuffer* self, void* item);
 static void* pop_func(Ringbuffer* self);
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n);
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max);
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+static bool resize_func(Ringbuffer* self, size_t new_capacity);
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats);
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event);
 static Ringbuffer* free_func(Ringbuffer* self);
 
 static void cache_free(void* item, void* cache);
@@ -82,6 +92,14 @@ Ringbuffer* caching_ringbuffer_create(
         .capacity = capacity_func,
         .add = add_func,
         .pop = pop_func,
+        .add_n = add_n_func,
+        .pop_n = pop_n_func,
+        .pop_wait = pop_wait_func,
+        .add_wait = add_wait_func,
+        .resize = resize_func,
+        .stats = stats_func,
+        .latency = latency_func,
+        .event_fd = event_fd_func,
         .free = free_func,
     };
 
@@ -182,6 +200,192 @@ error:
 
 /*----------------------------------------------------------------------------*/
 
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->add_n(buffer, items, n);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->pop_n(buffer, out, max);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->pop_wait(buffer, timeout_usecs);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->add_wait(buffer, item, timeout_usecs);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * The cache is resized first, since elements the buffer drops cannot be
+ * restored if resizing the cache failed afterwards.
+ * If resizing the buffer fails, the cache gets its old capacity back.
+ * Cached elements dropped by shrinking the cache are gone, though.
+ */
+static bool resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+    Ringbuffer* cache = internal->cache;
+
+    if((0 == buffer) || (0 == cache)) goto error;
+
+    size_t old_capacity = cache->capacity(cache);
+
+    if(! cache->resize(cache, new_capacity)) goto error;
+
+    if(! buffer->resize(buffer, new_capacity)) {
+        cache->resize(cache, old_capacity);
+        goto error;
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Every pop from the cache is a request by caching_ringbuffer_get_cached
+ */
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+    Ringbuffer* cache = internal->cache;
+
+    if((0 == buffer) || (0 == cache)) goto error;
+
+    RingbufferStats cache_stats;
+
+    if(! cache->stats(cache, &cache_stats)) goto error;
+    if(! buffer->stats(buffer, stats)) goto error;
+
+    stats->cache_hits = cache_stats.pops;
+    stats->cache_misses = cache_stats.empty_pops;
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Only the latency of the buffer is of interest, the cache just keeps
+ * popped items for reuse.
+ */
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->latency(buffer, latency, reset);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+    Ringbuffer* buffer = internal->buffer;
+
+    if(0 == buffer) goto error;
+
+    return buffer->event_fd(buffer, event);
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
 static Ringbuffer* free_func(Ringbuffer* self) {
 
     if(0 == self) goto error;
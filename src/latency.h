@@ -0,0 +1,155 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Private helpers to record the latencies behind Ringbuffer.latency.
+ * Unless RINGBUFFER_LATENCY is defined, the LATENCY_ macros expand to
+ * nothing, their arguments are not evaluated and neither timestamps nor
+ * histograms need to exist.
+ *
+ * Like the statistics counters, histogram buckets are relaxed atomics,
+ * single-writer unless recorded with LATENCY_RECORD_SHARED.
+ * Resetting does not touch the buckets, but remembers their values in
+ * baseline, thus the writers remain the only ones writing them.
+ */
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+/*----------------------------------------------------------------------------*/
+
+#include "../include/ringbuffer_latency.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    atomic_size_t counts[RINGBUFFER_LATENCY_BUCKETS];
+
+    /* Touched by the thread calling latency() only */
+    size_t baseline[RINGBUFFER_LATENCY_BUCKETS];
+
+} Histogram;
+
+/*----------------------------------------------------------------------------*/
+
+#if defined(RINGBUFFER_LATENCY)
+
+/**
+ * CLOCK_MONOTONIC is served by the vDSO without a system call.
+ * rdtsc would be cheaper, but requires calibration and an invariant TSC,
+ * CLOCK_MONOTONIC_COARSE is too coarse with its resolution of milliseconds.
+ */
+static inline uint64_t latency_now(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+static inline void latency_record(
+        Histogram* histogram, uint64_t timestamp, uint64_t now) {
+
+    atomic_size_t* count =
+        histogram->counts + ringbuffer_latency_bucket(now - timestamp);
+
+    atomic_store_explicit(count,
+            1 + atomic_load_explicit(count, memory_order_relaxed),
+            memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void latency_record_shared(
+        Histogram* histogram, uint64_t timestamp, uint64_t now) {
+
+    atomic_fetch_add_explicit(
+            histogram->counts + ringbuffer_latency_bucket(now - timestamp),
+            1, memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void latency_get(
+        Histogram* histogram, RingbufferLatency* out, bool reset) {
+
+    out->num_samples = 0;
+
+    for(size_t i = 0; i < RINGBUFFER_LATENCY_BUCKETS; ++i) {
+
+        size_t count = atomic_load_explicit(
+                histogram->counts + i, memory_order_relaxed);
+
+        out->counts[i] = count - histogram->baseline[i];
+        out->num_samples += out->counts[i];
+
+        if(reset) {
+            histogram->baseline[i] = count;
+        }
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#if defined(RINGBUFFER_LATENCY)
+
+#define LATENCY_NOW(now) uint64_t now = latency_now()
+#define LATENCY_STAMP(timestamp, now) (timestamp) = (now)
+#define LATENCY_RECORD(histogram, timestamp, now) \
+    latency_record(histogram, timestamp, now)
+#define LATENCY_RECORD_SHARED(histogram, timestamp, now) \
+    latency_record_shared(histogram, timestamp, now)
+
+#else
+
+#define LATENCY_NOW(now)
+#define LATENCY_STAMP(timestamp, now)
+#define LATENCY_RECORD(histogram, timestamp, now)
+#define LATENCY_RECORD_SHARED(histogram, timestamp, now)
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+#endif
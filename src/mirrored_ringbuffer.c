@@ -0,0 +1,376 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/mirrored_ringbuffer.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(MirroredRingbuffer* self);
+
+static uint8_t* write_span_func(MirroredRingbuffer* self, size_t* length);
+
+static bool produce_func(MirroredRingbuffer* self, size_t length);
+
+static uint8_t* read_span_func(MirroredRingbuffer* self, size_t* length);
+
+static bool consume_func(MirroredRingbuffer* self, size_t length);
+
+static MirroredRingbuffer* free_func(MirroredRingbuffer* self);
+
+static uint8_t* map_mirrored(size_t num_bytes);
+
+static void unmap_mirrored(uint8_t* memory, size_t num_bytes);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * memory[i] and memory[i + capacity_bytes] refer to the same byte.
+ * next_to_write and next_to_read are never wrapped, the offset into
+ * memory is determined by masking with index_mask.
+ */
+typedef struct InternalMirroredRingbuffer {
+
+    MirroredRingbuffer public;
+
+    size_t capacity_bytes;
+    size_t index_mask;
+    uint8_t* memory;
+
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_write;
+
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_read;
+
+} InternalMirroredRingbuffer;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+MirroredRingbuffer* mirrored_ringbuffer_create(size_t capacity_bytes) {
+
+    if(0 >= capacity_bytes) {
+        goto error;
+    }
+
+#if defined(__linux__)
+
+    size_t num_bytes = sysconf(_SC_PAGESIZE);
+
+#else
+
+    size_t num_bytes = 1;
+
+#endif
+
+    while(num_bytes < capacity_bytes) {
+        num_bytes <<= 1;
+    }
+
+    InternalMirroredRingbuffer* buffer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalMirroredRingbuffer));
+
+    if(0 == buffer) goto error;
+
+    memset(buffer, 0, sizeof(InternalMirroredRingbuffer));
+
+    buffer->memory = map_mirrored(num_bytes);
+
+    if(0 == buffer->memory) {
+        free(buffer);
+        goto error;
+    }
+
+    buffer->capacity_bytes = num_bytes;
+    buffer->index_mask = num_bytes - 1;
+
+    atomic_init(&buffer->next_to_write, 0);
+    atomic_init(&buffer->next_to_read, 0);
+
+    buffer->public = (MirroredRingbuffer) {
+        .capacity = capacity_func,
+        .write_span = write_span_func,
+        .produce = produce_func,
+        .read_span = read_span_func,
+        .consume = consume_func,
+        .free = free_func,
+    };
+
+    return (MirroredRingbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+#if defined(__linux__)
+
+static uint8_t* map_mirrored(size_t num_bytes) {
+
+    int fd = memfd_create("mirrored_ringbuffer", MFD_CLOEXEC);
+
+    if(0 > fd) goto error;
+
+    if(0 != ftruncate(fd, num_bytes)) goto close_fd;
+
+    /* Reserve address space for both mappings first */
+    uint8_t* memory = mmap(0, 2 * num_bytes, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(MAP_FAILED == memory) goto close_fd;
+
+    if(MAP_FAILED == mmap(memory, num_bytes, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED, fd, 0)) {
+        goto unmap;
+    }
+
+    if(MAP_FAILED == mmap(memory + num_bytes, num_bytes,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)) {
+        goto unmap;
+    }
+
+    close(fd);
+
+    return memory;
+
+unmap:
+
+    munmap(memory, 2 * num_bytes);
+
+close_fd:
+
+    close(fd);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void unmap_mirrored(uint8_t* memory, size_t num_bytes) {
+
+    munmap(memory, 2 * num_bytes);
+
+}
+
+#else
+
+static uint8_t* map_mirrored(size_t num_bytes) {
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void unmap_mirrored(uint8_t* memory, size_t num_bytes) {
+
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+static size_t capacity_func(MirroredRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    return internal->capacity_bytes;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline size_t free_bytes(
+        InternalMirroredRingbuffer* internal, size_t write) {
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_acquire);
+
+    return internal->capacity_bytes - (write - read);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline size_t used_bytes(
+        InternalMirroredRingbuffer* internal, size_t read) {
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_acquire);
+
+    return write - read;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static uint8_t* write_span_func(MirroredRingbuffer* self, size_t* length) {
+
+    if(0 == self) goto error;
+    if(0 == length) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    *length = free_bytes(internal, write);
+
+    return internal->memory + (write & internal->index_mask);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool produce_func(MirroredRingbuffer* self, size_t length) {
+
+    if(0 == self) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    if(length > free_bytes(internal, write)) goto error;
+
+    atomic_store_explicit(
+            &internal->next_to_write, write + length, memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static uint8_t* read_span_func(MirroredRingbuffer* self, size_t* length) {
+
+    if(0 == self) goto error;
+    if(0 == length) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    *length = used_bytes(internal, read);
+
+    return internal->memory + (read & internal->index_mask);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool consume_func(MirroredRingbuffer* self, size_t length) {
+
+    if(0 == self) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    if(length > used_bytes(internal, read)) goto error;
+
+    atomic_store_explicit(
+            &internal->next_to_read, read + length, memory_order_release);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static MirroredRingbuffer* free_func(MirroredRingbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalMirroredRingbuffer* internal = (InternalMirroredRingbuffer*) self;
+
+    unmap_mirrored(internal->memory, internal->capacity_bytes);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,884 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/mpmc_ringbuffer.h"
+#include "waiter.h"
+#include "stats.h"
+#include "latency.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(Ringbuffer* self);
+
+static bool add_func(Ringbuffer* self, void* item);
+
+static void* pop_func(Ringbuffer* self);
+
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool add_block_func(Ringbuffer* self, void* item);
+
+static size_t add_n_block_func(Ringbuffer* self, void** items, size_t n);
+
+static bool resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* free_func(Ringbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * The sequence tells which operation the slot is ready for:
+ * If sequence == position, the slot is empty and might be written by
+ * the producer that claimed position.
+ * If sequence == position + 1, the slot is filled and might be read
+ * by the consumer that claimed position.
+ */
+typedef struct {
+
+    atomic_size_t sequence;
+    void* item;
+
+#if defined(RINGBUFFER_LATENCY)
+    uint64_t timestamp;
+#endif
+
+} Slot;
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct InternalRingbuffer {
+
+    Ringbuffer public;
+
+    size_t index_mask;
+    Slot* slots;
+
+    void (*free_item)(void* item, void* additional_arg);
+    void* free_item_additional_arg;
+
+    /* Set on creation only: Whether add and pop notify waiting threads */
+    bool waitable;
+
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_write;
+
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+#endif
+
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_read;
+
+#if defined(RINGBUFFER_STATS)
+    PopStats pop_stats;
+#endif
+
+#if defined(RINGBUFFER_LATENCY)
+    /* Recorded by all consumers */
+    alignas(CACHE_LINE_SIZE) Histogram latency;
+#endif
+
+    alignas(CACHE_LINE_SIZE) Waiter not_empty;
+
+    alignas(CACHE_LINE_SIZE) Waiter not_full;
+
+} InternalRingbuffer;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+Ringbuffer* mpmc_ringbuffer_create(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    return mpmc_ringbuffer_create_with_policy(capacity, RINGBUFFER_REJECT,
+            free_item, free_item_additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* mpmc_ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    if(0 >= capacity) {
+        goto error;
+    }
+
+    bool waitable = 0 != (RINGBUFFER_WAITABLE & policy);
+    policy &= ~RINGBUFFER_WAITABLE;
+
+    if((RINGBUFFER_REJECT != policy) && (RINGBUFFER_BLOCK != policy)) {
+        goto error;
+    }
+
+    waitable = waitable || (RINGBUFFER_BLOCK == policy);
+
+    size_t num_slots = 1;
+
+    while(num_slots < capacity) {
+        num_slots <<= 1;
+    }
+
+    InternalRingbuffer* buffer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalRingbuffer));
+
+    if(0 == buffer) goto error;
+
+    memset(buffer, 0, sizeof(InternalRingbuffer));
+
+    buffer->slots = calloc(num_slots, sizeof(Slot));
+
+    if(0 == buffer->slots) {
+        free(buffer);
+        goto error;
+    }
+
+    for(size_t i = 0; i < num_slots; ++i) {
+        atomic_init(&buffer->slots[i].sequence, i);
+    }
+
+    buffer->index_mask = num_slots - 1;
+    buffer->free_item = free_item;
+    buffer->free_item_additional_arg = free_item_additional_arg;
+    buffer->waitable = waitable;
+
+    atomic_init(&buffer->next_to_write, 0);
+    atomic_init(&buffer->next_to_read, 0);
+
+    waiter_init(&buffer->not_empty);
+    waiter_init(&buffer->not_full);
+
+    buffer->public = (Ringbuffer) {
+        .capacity = capacity_func,
+        .add = add_func,
+        .pop = pop_func,
+        .add_n = add_n_func,
+        .pop_n = pop_n_func,
+        .pop_wait = pop_wait_func,
+        .add_wait = add_wait_func,
+        .resize = resize_func,
+        .stats = stats_func,
+        .latency = latency_func,
+        .event_fd = event_fd_func,
+        .free = free_func,
+    };
+
+    if(RINGBUFFER_BLOCK == policy) {
+        buffer->public.add = add_block_func;
+        buffer->public.add_n = add_n_block_func;
+    }
+
+    return (Ringbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+/**
+ * Since next_to_read might be changed concurrently, it might be ahead of
+ * write.
+ * @return number of elements contained once position write has been added
+ */
+static inline size_t num_items_until(InternalRingbuffer* internal, size_t write) {
+
+    size_t num_items = write - atomic_load_explicit(
+            &internal->next_to_read, memory_order_relaxed);
+
+    return (num_items > internal->index_mask + 1) ? 0 : num_items;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    return internal->index_mask + 1;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    Slot* slot = 0;
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    for(;;) {
+
+        slot = internal->slots + (write & internal->index_mask);
+
+        size_t sequence =
+            atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        intptr_t diff = (intptr_t) sequence - (intptr_t) write;
+
+        if(0 == diff) {
+
+            if(atomic_compare_exchange_weak_explicit(
+                        &internal->next_to_write, &write, write + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+
+        } else if(0 > diff) {
+
+            /* Slot still holds the element of the previous round: full */
+            if(waiter_rearm(&internal->not_full)) {
+                return add_func(self, item);
+            }
+
+            goto error;
+
+        } else {
+
+            write = atomic_load_explicit(
+                    &internal->next_to_write, memory_order_relaxed);
+
+        }
+
+    }
+
+    LATENCY_NOW(now);
+    LATENCY_STAMP(slot->timestamp, now);
+
+    slot->item = item;
+    atomic_store_explicit(&slot->sequence, write + 1, memory_order_release);
+
+    STATS_ADD_SHARED(&internal->add_stats.adds, 1);
+    STATS_WATERMARK_SHARED(&internal->add_stats.high_watermark,
+            num_items_until(internal, write + 1));
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_empty);
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    Slot* slot = 0;
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    for(;;) {
+
+        slot = internal->slots + (read & internal->index_mask);
+
+        size_t sequence =
+            atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        intptr_t diff = (intptr_t) sequence - (intptr_t) (read + 1);
+
+        if(0 == diff) {
+
+            if(atomic_compare_exchange_weak_explicit(
+                        &internal->next_to_read, &read, read + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+
+        } else if(0 > diff) {
+
+            /* Slot not yet written: empty */
+            if(waiter_rearm(&internal->not_empty)) {
+                return pop_func(self);
+            }
+
+            STATS_ADD_SHARED(&internal->pop_stats.empty_pops, 1);
+            goto error;
+
+        } else {
+
+            read = atomic_load_explicit(
+                    &internal->next_to_read, memory_order_relaxed);
+
+        }
+
+    }
+
+    LATENCY_NOW(now);
+    LATENCY_RECORD_SHARED(&internal->latency, slot->timestamp, now);
+
+    void* retval = slot->item;
+    atomic_store_explicit(&slot->sequence,
+            read + internal->index_mask + 1, memory_order_release);
+
+    STATS_ADD_SHARED(&internal->pop_stats.pops, 1);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return retval;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Claims up to n consecutive slots from next_to_write on that are ready
+ * to be written. Checking the slots before the CAS is sufficient:
+ * A slot that is ready for position p is only ever changed by the producer
+ * that claimed p.
+ */
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    for(size_t i = 0; i < n; ++i) {
+
+        if(0 == items[i]) {
+            n = i;
+            break;
+        }
+
+    }
+
+    if(0 == n) goto error;
+
+    size_t num_claimed = 0;
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    for(;;) {
+
+        num_claimed = 0;
+
+        while(num_claimed < n) {
+
+            Slot* slot =
+                internal->slots + ((write + num_claimed) & internal->index_mask);
+
+            size_t sequence =
+                atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+            if(sequence != write + num_claimed) {
+                break;
+            }
+
+            ++num_claimed;
+
+        }
+
+        if(0 == num_claimed) {
+
+            Slot* slot = internal->slots + (write & internal->index_mask);
+
+            size_t sequence =
+                atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+            if(0 > (intptr_t) sequence - (intptr_t) write) {
+
+                if(waiter_rearm(&internal->not_full)) {
+                    return add_n_func(self, items, n);
+                }
+
+                goto error;
+
+            }
+
+            write = atomic_load_explicit(
+                    &internal->next_to_write, memory_order_relaxed);
+
+            continue;
+
+        }
+
+        if(atomic_compare_exchange_weak_explicit(
+                    &internal->next_to_write, &write, write + num_claimed,
+                    memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+
+    }
+
+    LATENCY_NOW(now);
+
+    for(size_t i = 0; i < num_claimed; ++i) {
+
+        Slot* slot = internal->slots + ((write + i) & internal->index_mask);
+
+        LATENCY_STAMP(slot->timestamp, now);
+        slot->item = items[i];
+        atomic_store_explicit(
+                &slot->sequence, write + i + 1, memory_order_release);
+
+    }
+
+    STATS_ADD_SHARED(&internal->add_stats.adds, num_claimed);
+    STATS_WATERMARK_SHARED(&internal->add_stats.high_watermark,
+            num_items_until(internal, write + num_claimed));
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_empty);
+    }
+
+    return num_claimed;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+    if(0 == out) goto error;
+    if(0 == max) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t num_claimed = 0;
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    for(;;) {
+
+        num_claimed = 0;
+
+        while(num_claimed < max) {
+
+            Slot* slot =
+                internal->slots + ((read + num_claimed) & internal->index_mask);
+
+            size_t sequence =
+                atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+            if(sequence != read + num_claimed + 1) {
+                break;
+            }
+
+            ++num_claimed;
+
+        }
+
+        if(0 == num_claimed) {
+
+            Slot* slot = internal->slots + (read & internal->index_mask);
+
+            size_t sequence =
+                atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+            if(0 > (intptr_t) sequence - (intptr_t) (read + 1)) {
+
+                if(waiter_rearm(&internal->not_empty)) {
+                    return pop_n_func(self, out, max);
+                }
+
+                goto error;
+
+            }
+
+            read = atomic_load_explicit(
+                    &internal->next_to_read, memory_order_relaxed);
+
+            continue;
+
+        }
+
+        if(atomic_compare_exchange_weak_explicit(
+                    &internal->next_to_read, &read, read + num_claimed,
+                    memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+
+    }
+
+    LATENCY_NOW(now);
+
+    for(size_t i = 0; i < num_claimed; ++i) {
+
+        Slot* slot = internal->slots + ((read + i) & internal->index_mask);
+
+        LATENCY_RECORD_SHARED(&internal->latency, slot->timestamp, now);
+        out[i] = slot->item;
+        atomic_store_explicit(&slot->sequence,
+                read + i + internal->index_mask + 1, memory_order_release);
+
+    }
+
+    STATS_ADD_SHARED(&internal->pop_stats.pops, num_claimed);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return num_claimed;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) {
+        return pop_func(self);
+    }
+
+    return waiter_pop_wait(
+            &internal->not_empty, self, pop_func, timeout_usecs);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) {
+        return add_func(self, item);
+    }
+
+    return waiter_add_wait(
+            &internal->not_full, self, add_func, item, timeout_usecs);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_block_func(Ringbuffer* self, void* item) {
+
+    return add_wait_func(self, item, -1);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_block_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    for(;;) {
+
+        num_added += add_n_func(self, items + num_added, n - num_added);
+
+        if((num_added == n) || (0 == items[num_added])) {
+            break;
+        }
+
+        if(! add_wait_func(self, items[num_added], -1)) {
+            break;
+        }
+
+        ++num_added;
+
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Not thread-safe: Moves all elements to the start of a new array of slots
+ */
+static bool resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+    if(0 == new_capacity) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t num_slots = 1;
+
+    while(num_slots < new_capacity) {
+        num_slots <<= 1;
+    }
+
+    Slot* slots = calloc(num_slots, sizeof(Slot));
+
+    if(0 == slots) goto error;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    for(; write - read > num_slots; ++read) {
+
+        STATS_ADD(&internal->add_stats.overwrites, 1);
+
+        if(0 != internal->free_item) {
+            internal->free_item(
+                    internal->slots[read & internal->index_mask].item,
+                    internal->free_item_additional_arg);
+        }
+
+    }
+
+    size_t num_items = 0;
+
+    for(; read != write; ++read, ++num_items) {
+
+        slots[num_items].item =
+            internal->slots[read & internal->index_mask].item;
+        LATENCY_STAMP(slots[num_items].timestamp,
+                internal->slots[read & internal->index_mask].timestamp);
+        atomic_init(&slots[num_items].sequence, num_items + 1);
+
+    }
+
+    for(size_t i = num_items; i < num_slots; ++i) {
+        atomic_init(&slots[i].sequence, i);
+    }
+
+    free(internal->slots);
+
+    internal->slots = slots;
+    internal->index_mask = num_slots - 1;
+
+    atomic_store_explicit(&internal->next_to_write, num_items,
+            memory_order_relaxed);
+    atomic_store_explicit(&internal->next_to_read, 0, memory_order_relaxed);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    stats_get(stats, &internal->add_stats, &internal->pop_stats,
+            num_items_until(internal, atomic_load_explicit(
+                    &internal->next_to_write, memory_order_relaxed)));
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    if(0 == self) goto error;
+    if(0 == latency) goto error;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    latency_get(&internal->latency, latency, reset);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) goto error;
+
+    switch(event) {
+
+        case RINGBUFFER_NOT_EMPTY:
+            return waiter_event_fd(&internal->not_empty);
+
+        case RINGBUFFER_NOT_FULL:
+            return waiter_event_fd(&internal->not_full);
+
+    }
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(0 != internal->free_item) {
+
+        void* item = 0;
+
+        while(0 != (item = pop_func(self))) {
+            internal->free_item(item, internal->free_item_additional_arg);
+        }
+
+    }
+
+    waiter_destroy(&internal->not_empty);
+    waiter_destroy(&internal->not_full);
+
+    free(internal->slots);
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,358 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/reclaimer.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static bool collect_func(Reclaimer* self, void* item);
+
+static bool flush_func(Reclaimer* self);
+
+static size_t reclaim_func(Reclaimer* self);
+
+static Reclaimer* free_func(Reclaimer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+typedef struct Batch {
+
+    struct Batch* next;
+    size_t num_items;
+    void* items[];
+
+} Batch;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Batches circulate between the collecting thread and reclaim:
+ * The collecting thread fills current and pushes it onto full.
+ * reclaim takes all of full at once, empties the batches and pushes them
+ * onto empty.
+ * The collecting thread takes all of empty at once if it runs out of
+ * spare batches.
+ * Since both lists are only ever emptied as a whole, there is no ABA problem.
+ */
+typedef struct InternalReclaimer {
+
+    Reclaimer public;
+
+    size_t batch_size;
+
+    void (*free_items)(void** items, size_t n, void* additional_arg);
+    void* free_items_additional_arg;
+
+    /* Used by the collecting thread only */
+    Batch* current;
+    Batch* spare;
+
+    alignas(CACHE_LINE_SIZE) _Atomic(Batch*) full;
+
+    alignas(CACHE_LINE_SIZE) _Atomic(Batch*) empty;
+
+} InternalReclaimer;
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+Reclaimer* reclaimer_create(
+        size_t batch_size,
+        size_t num_batches,
+        void (*free_items)(void** items, size_t n, void* additional_arg),
+        void* free_items_additional_arg) {
+
+    if(0 == batch_size) goto error;
+    if(0 == num_batches) goto error;
+    if(0 == free_items) goto error;
+
+    InternalReclaimer* reclaimer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalReclaimer));
+
+    if(0 == reclaimer) goto error;
+
+    memset(reclaimer, 0, sizeof(InternalReclaimer));
+
+    reclaimer->batch_size = batch_size;
+    reclaimer->free_items = free_items;
+    reclaimer->free_items_additional_arg = free_items_additional_arg;
+
+    atomic_init(&reclaimer->full, 0);
+    atomic_init(&reclaimer->empty, 0);
+
+    reclaimer->public = (Reclaimer) {
+        .collect = collect_func,
+        .flush = flush_func,
+        .reclaim = reclaim_func,
+        .free = free_func,
+    };
+
+    /* One more for current, which is not awaiting reclaim */
+    for(size_t i = 0; i < num_batches + 1; ++i) {
+
+        Batch* batch = calloc(1, sizeof(Batch) + batch_size * sizeof(void*));
+
+        if(0 == batch) {
+            free_func((Reclaimer*) reclaimer);
+            goto error;
+        }
+
+        batch->next = reclaimer->spare;
+        reclaimer->spare = batch;
+
+    }
+
+    reclaimer->current = reclaimer->spare;
+    reclaimer->spare = reclaimer->current->next;
+    reclaimer->current->next = 0;
+
+    return (Reclaimer*) reclaimer;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void reclaimer_free_item(void* item, void* reclaimer) {
+
+    Reclaimer* self = reclaimer;
+
+    if(0 == self) goto error;
+
+    self->collect(self, item);
+
+error:
+
+    return;
+
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static void push(_Atomic(Batch*)* list, Batch* batch) {
+
+    Batch* head = atomic_load_explicit(list, memory_order_relaxed);
+
+    do {
+
+        batch->next = head;
+
+    } while(! atomic_compare_exchange_weak_explicit(
+                list, &head, batch,
+                memory_order_release, memory_order_relaxed));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Hands current over to reclaim
+ * @return false if there was no empty batch to continue with
+ */
+static bool publish_current(InternalReclaimer* internal) {
+
+    if(0 == internal->spare) {
+        internal->spare = atomic_exchange_explicit(
+                &internal->empty, 0, memory_order_acquire);
+    }
+
+    Batch* next = internal->spare;
+
+    if(0 == next) goto error;
+
+    internal->spare = next->next;
+    next->next = 0;
+
+    push(&internal->full, internal->current);
+    internal->current = next;
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool collect_func(Reclaimer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalReclaimer* internal = (InternalReclaimer*) self;
+
+    Batch* current = internal->current;
+
+    current->items[current->num_items++] = item;
+
+    if(current->num_items < internal->batch_size) {
+        return true;
+    }
+
+    if(! publish_current(internal)) {
+
+        /* reclaim lags behind - do not collect more than num_batches */
+        internal->free_items(current->items, current->num_items,
+                internal->free_items_additional_arg);
+        current->num_items = 0;
+
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool flush_func(Reclaimer* self) {
+
+    if(0 == self) goto error;
+
+    InternalReclaimer* internal = (InternalReclaimer*) self;
+
+    if(0 == internal->current->num_items) {
+        return true;
+    }
+
+    return publish_current(internal);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t reclaim_func(Reclaimer* self) {
+
+    if(0 == self) goto error;
+
+    InternalReclaimer* internal = (InternalReclaimer*) self;
+
+    size_t num_freed = 0;
+
+    Batch* batch =
+        atomic_exchange_explicit(&internal->full, 0, memory_order_acquire);
+
+    while(0 != batch) {
+
+        Batch* next = batch->next;
+
+        internal->free_items(batch->items, batch->num_items,
+                internal->free_items_additional_arg);
+
+        num_freed += batch->num_items;
+        batch->num_items = 0;
+
+        push(&internal->empty, batch);
+        batch = next;
+
+    }
+
+    return num_freed;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void free_batches(Batch* batch) {
+
+    while(0 != batch) {
+
+        Batch* next = batch->next;
+        free(batch);
+        batch = next;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Reclaimer* free_func(Reclaimer* self) {
+
+    if(0 == self) goto error;
+
+    InternalReclaimer* internal = (InternalReclaimer*) self;
+
+    reclaim_func(self);
+
+    if((0 != internal->current) && (0 < internal->current->num_items)) {
+        internal->free_items(internal->current->items,
+                internal->current->num_items,
+                internal->free_items_additional_arg);
+    }
+
+    free_batches(internal->current);
+    free_batches(internal->spare);
+    free_batches(atomic_load_explicit(&internal->empty, memory_order_relaxed));
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
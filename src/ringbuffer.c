@@ -32,7 +32,11 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
+
 #include "../include/ringbuffer.h"
+#include "stats.h"
+#include "latency.h"
 
 /******************************************************************************
                                PRIVATE PROTOTYPES
@@ -44,6 +48,31 @@ static bool add_func(Ringbuffer* self, void* item);
 
 static void* pop_func(Ringbuffer* self);
 
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool add_reject_func(Ringbuffer* self, void* item);
+
+static size_t add_n_reject_func(Ringbuffer* self, void** items, size_t n);
+
+static bool add_wait_reject_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
 static Ringbuffer* free_func(Ringbuffer* self);
 
 /******************************************************************************
@@ -53,6 +82,9 @@ static Ringbuffer* free_func(Ringbuffer* self);
 typedef struct Entry {
     void* item;
     struct Entry* next;
+#if defined(RINGBUFFER_LATENCY)
+    uint64_t timestamp;
+#endif
 } Entry;
 
 /*----------------------------------------------------------------------------*/
@@ -63,13 +95,37 @@ typedef struct InternalRingbuffer {
 
     Entry* next_entry_to_read;
     Entry* next_entry_to_write;
+    size_t num_items;
     size_t max_num_items;
 
     void (*free_item)(void* item, void* additional_arg);
     void* free_item_additional_arg;
 
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+    PopStats pop_stats;
+#endif
+
+#if defined(RINGBUFFER_LATENCY)
+    Histogram latency;
+#endif
+
 } InternalRingbuffer;
 
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return start of a new circular list of num_entries empty entries
+ */
+static Entry* create_entries(size_t num_entries);
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Frees all entries of a circular list, but not the items
+ */
+static void free_entries(Entry* start);
+
 /******************************************************************************
                                 PUBLIC FUNCTIONS
  ******************************************************************************/
@@ -79,24 +135,38 @@ Ringbuffer* ringbuffer_create(
         void (*free_item)(void* item, void* additional_arg),
         void* free_item_additional_arg) {
 
-    if(0 >= capacity) {
-        goto error;
-    }
+    return ringbuffer_create_with_policy(capacity, RINGBUFFER_OVERWRITE,
+            free_item, free_item_additional_arg);
 
-    Entry* list_start = calloc(1, sizeof(Entry));
-    Entry* next = list_start;
+}
 
-    for(size_t i = 1; i < capacity; ++i) {
+/*----------------------------------------------------------------------------*/
 
-        next->next = calloc(1, sizeof(Entry));
-        next = next->next;
+Ringbuffer* ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
 
+    if(0 >= capacity) {
+        goto error;
     }
 
-    next->next = list_start;
+    if((RINGBUFFER_OVERWRITE != policy) && (RINGBUFFER_REJECT != policy)) {
+        goto error;
+    }
+
+    Entry* list_start = create_entries(capacity);
+
+    if(0 == list_start) goto error;
 
     InternalRingbuffer* buffer = calloc(1, sizeof(InternalRingbuffer));
 
+    if(0 == buffer) {
+        free_entries(list_start);
+        goto error;
+    }
+
     *buffer = (InternalRingbuffer) {
         .next_entry_to_write = list_start,
         .next_entry_to_read = list_start,
@@ -109,9 +179,22 @@ Ringbuffer* ringbuffer_create(
         .capacity = capacity_func,
         .add = add_func,
         .pop = pop_func,
+        .add_n = add_n_func,
+        .pop_n = pop_n_func,
+        .pop_wait = pop_wait_func,
+        .add_wait = add_wait_func,
+        .resize = resize_func,
+        .stats = stats_func,
+        .latency = latency_func,
+        .event_fd = event_fd_func,
         .free = free_func,
     };
 
+    if(RINGBUFFER_REJECT == policy) {
+        buffer->public.add = add_reject_func;
+        buffer->public.add_n = add_n_reject_func;
+        buffer->public.add_wait = add_wait_reject_func;
+    }
 
     return (Ringbuffer*)buffer;
 
@@ -124,6 +207,55 @@ error:
   PRIVATE FUNCTIONS
  ******************************************************************************/
 
+static Entry* create_entries(size_t num_entries) {
+
+    Entry* list_start = calloc(1, sizeof(Entry));
+
+    if(0 == list_start) goto error;
+
+    Entry* next = list_start;
+    next->next = list_start;
+
+    for(size_t i = 1; i < num_entries; ++i) {
+
+        next->next = calloc(1, sizeof(Entry));
+
+        if(0 == next->next) {
+            next->next = list_start;
+            free_entries(list_start);
+            goto error;
+        }
+
+        next = next->next;
+        next->next = list_start;
+
+    }
+
+    return list_start;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void free_entries(Entry* start) {
+
+    Entry* current = start;
+
+    do {
+
+        Entry* next = current->next;
+        free(current);
+        current = next;
+
+    } while(current != start);
+
+}
+
+/*----------------------------------------------------------------------------*/
 
 static size_t capacity_func(Ringbuffer* self) {
 
@@ -154,15 +286,32 @@ static bool add_func(Ringbuffer* self, void* item) {
         internal->next_entry_to_read = read->next;
     }
 
-    if((0 != write->item) && (0 != internal->free_item)) {
-        internal->free_item(
-                write->item,
-                internal->free_item_additional_arg);
+    if(0 != write->item) {
+
+        STATS_ADD(&internal->add_stats.overwrites, 1);
+        --internal->num_items;
+
+        if(0 != internal->free_item) {
+            internal->free_item(
+                    write->item,
+                    internal->free_item_additional_arg);
+        }
+
     }
 
+    LATENCY_NOW(now);
+    LATENCY_STAMP(write->timestamp, now);
+
     write->item = item;
     internal->next_entry_to_write = write->next;
 
+    if(0 != item) {
+        ++internal->num_items;
+    }
+
+    STATS_ADD(&internal->add_stats.adds, 1);
+    STATS_WATERMARK(&internal->add_stats.high_watermark, internal->num_items);
+
     return true;
 
 error:
@@ -182,12 +331,19 @@ static void* pop_func(Ringbuffer* self) {
     Entry* read = internal->next_entry_to_read;
 
     if(0 == read->item) {
+        STATS_ADD(&internal->pop_stats.empty_pops, 1);
         return 0;
     }
 
+    LATENCY_NOW(now);
+    LATENCY_RECORD(&internal->latency, read->timestamp, now);
+
     void* retval = read->item;
     read->item = 0;
     internal->next_entry_to_read = read->next;
+    --internal->num_items;
+
+    STATS_ADD(&internal->pop_stats.pops, 1);
 
     return retval;
 
@@ -199,6 +355,257 @@ error:
 
 /*----------------------------------------------------------------------------*/
 
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    for(size_t i = 0; i < n; ++i) {
+        add_func(self, items[i]);
+    }
+
+    return n;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+    if(0 == out) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(max > internal->num_items) {
+        max = internal->num_items;
+    }
+
+    for(size_t i = 0; i < max; ++i) {
+        out[i] = pop_func(self);
+    }
+
+    return max;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Nobody could add an element while waiting - thus just pop
+ */
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    return pop_func(self);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Elements are overwritten, thus add never has to wait
+ */
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return add_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_reject_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    Entry* write = internal->next_entry_to_write;
+
+    /* Entries are cleared on pop, thus only the full ringbuffer is occupied */
+    if(0 != write->item) goto error;
+
+    LATENCY_NOW(now);
+    LATENCY_STAMP(write->timestamp, now);
+
+    write->item = item;
+    internal->next_entry_to_write = write->next;
+
+    if(0 != item) {
+        ++internal->num_items;
+    }
+
+    STATS_ADD(&internal->add_stats.adds, 1);
+    STATS_WATERMARK(&internal->add_stats.high_watermark, internal->num_items);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_reject_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    while((num_added < n) && add_reject_func(self, items[num_added])) {
+        ++num_added;
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Nobody could pop an element while waiting - thus just add
+ */
+static bool add_wait_reject_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    return add_reject_func(self, item);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Moves all elements over to a new list of entries
+ */
+static bool resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+    if(0 == new_capacity) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    Entry* list_start = create_entries(new_capacity);
+
+    if(0 == list_start) goto error;
+
+    size_t num_items = internal->num_items;
+    Entry* read = internal->next_entry_to_read;
+
+    for(; num_items > new_capacity; --num_items) {
+
+        STATS_ADD(&internal->add_stats.overwrites, 1);
+
+        if(0 != internal->free_item) {
+            internal->free_item(
+                    read->item, internal->free_item_additional_arg);
+        }
+
+        read = read->next;
+
+    }
+
+    Entry* write = list_start;
+
+    for(size_t i = 0; i < num_items; ++i) {
+
+        write->item = read->item;
+        LATENCY_STAMP(write->timestamp, read->timestamp);
+        write = write->next;
+        read = read->next;
+
+    }
+
+    free_entries(internal->next_entry_to_read);
+
+    internal->next_entry_to_read = list_start;
+    internal->next_entry_to_write = write;
+    internal->num_items = num_items;
+    internal->max_num_items = new_capacity;
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    stats_get(stats, &internal->add_stats, &internal->pop_stats,
+            internal->num_items);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    if(0 == self) goto error;
+    if(0 == latency) goto error;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    latency_get(&internal->latency, latency, reset);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Not thread-safe, thus there is nobody to wait for the ringbuffer.
+ */
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
 static Ringbuffer* free_func(Ringbuffer* self) {
 
     if(0 == self) goto error;
@@ -0,0 +1,831 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/spsc_ringbuffer.h"
+#include "waiter.h"
+#include "stats.h"
+#include "latency.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/******************************************************************************
+                               PRIVATE PROTOTYPES
+ ******************************************************************************/
+
+static size_t capacity_func(Ringbuffer* self);
+
+static bool add_func(Ringbuffer* self, void* item);
+
+static void* pop_func(Ringbuffer* self);
+
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n);
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max);
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs);
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs);
+
+static bool add_block_func(Ringbuffer* self, void* item);
+
+static size_t add_n_block_func(Ringbuffer* self, void** items, size_t n);
+
+static bool resize_func(Ringbuffer* self, size_t new_capacity);
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats);
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset);
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event);
+
+static Ringbuffer* free_func(Ringbuffer* self);
+
+/******************************************************************************
+ *                         PRIVATE DATA STRUCTURES
+ ******************************************************************************/
+
+/**
+ * The slots are kept in segments.
+ * Growing beyond the number of slots of the current segment makes the
+ * producer continue in a new segment, starting at position next_start.
+ * The consumer drains the old segment up to next_start, then frees it and
+ * follows next.
+ */
+typedef struct Segment {
+
+    size_t index_mask;
+
+    /* Only valid once next is set */
+    size_t next_start;
+    _Atomic(struct Segment*) next;
+
+#if defined(RINGBUFFER_LATENCY)
+    /* Points behind items, one timestamp per slot */
+    uint64_t* timestamps;
+#endif
+
+    void* items[];
+
+} Segment;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * next_to_write and next_to_read are never wrapped, the slot is determined
+ * by masking with index_mask.
+ * Since the number of slots is a power of two, overflows of the
+ * counters are harmless.
+ *
+ * Both sides keep a private copy of the index of the other side and only
+ * reload it if the copy indicates a full/empty ringbuffer.
+ */
+typedef struct InternalRingbuffer {
+
+    Ringbuffer public;
+
+    /* Written by producer only, on resize */
+    atomic_size_t max_num_items;
+
+    void (*free_item)(void* item, void* additional_arg);
+    void* free_item_additional_arg;
+
+    /* Set on creation only: Whether add and pop notify waiting threads */
+    bool waitable;
+
+    /* Written by producer only */
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_write;
+    size_t cached_next_to_read;
+    Segment* write_segment;
+
+#if defined(RINGBUFFER_STATS)
+    AddStats add_stats;
+#endif
+
+    /* Written by consumer only */
+    alignas(CACHE_LINE_SIZE) atomic_size_t next_to_read;
+    size_t cached_next_to_write;
+    Segment* read_segment;
+
+#if defined(RINGBUFFER_STATS)
+    PopStats pop_stats;
+#endif
+
+#if defined(RINGBUFFER_LATENCY)
+    Histogram latency;
+#endif
+
+    alignas(CACHE_LINE_SIZE) Waiter not_empty;
+
+    alignas(CACHE_LINE_SIZE) Waiter not_full;
+
+} InternalRingbuffer;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return a segment with at least capacity slots
+ */
+static Segment* segment_create(size_t capacity) {
+
+    size_t num_slots = 1;
+
+    while(num_slots < capacity) {
+        num_slots <<= 1;
+    }
+
+    size_t slot_size = sizeof(void*);
+
+#if defined(RINGBUFFER_LATENCY)
+    slot_size += sizeof(uint64_t);
+#endif
+
+    Segment* segment = calloc(1, sizeof(Segment) + num_slots * slot_size);
+
+    if(0 == segment) goto error;
+
+    segment->index_mask = num_slots - 1;
+
+#if defined(RINGBUFFER_LATENCY)
+    segment->timestamps = (uint64_t*) (segment->items + num_slots);
+#endif
+    atomic_init(&segment->next, 0);
+
+    return segment;
+
+error:
+
+    return 0;
+
+}
+
+/******************************************************************************
+                                PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+Ringbuffer* spsc_ringbuffer_create(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    return spsc_ringbuffer_create_with_policy(capacity, RINGBUFFER_REJECT,
+            free_item, free_item_additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+Ringbuffer* spsc_ringbuffer_create_with_policy(
+        size_t capacity,
+        RingbufferPolicy policy,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    if(0 >= capacity) {
+        goto error;
+    }
+
+    bool waitable = 0 != (RINGBUFFER_WAITABLE & policy);
+    policy &= ~RINGBUFFER_WAITABLE;
+
+    if((RINGBUFFER_REJECT != policy) && (RINGBUFFER_BLOCK != policy)) {
+        goto error;
+    }
+
+    waitable = waitable || (RINGBUFFER_BLOCK == policy);
+
+    InternalRingbuffer* buffer =
+        aligned_alloc(CACHE_LINE_SIZE, sizeof(InternalRingbuffer));
+
+    if(0 == buffer) goto error;
+
+    memset(buffer, 0, sizeof(InternalRingbuffer));
+
+    Segment* segment = segment_create(capacity);
+
+    if(0 == segment) {
+        free(buffer);
+        goto error;
+    }
+
+    buffer->write_segment = segment;
+    buffer->read_segment = segment;
+    buffer->free_item = free_item;
+    buffer->free_item_additional_arg = free_item_additional_arg;
+    buffer->waitable = waitable;
+
+    atomic_init(&buffer->max_num_items, capacity);
+    atomic_init(&buffer->next_to_write, 0);
+    atomic_init(&buffer->next_to_read, 0);
+
+    waiter_init(&buffer->not_empty);
+    waiter_init(&buffer->not_full);
+
+    buffer->public = (Ringbuffer) {
+        .capacity = capacity_func,
+        .add = add_func,
+        .pop = pop_func,
+        .add_n = add_n_func,
+        .pop_n = pop_n_func,
+        .pop_wait = pop_wait_func,
+        .add_wait = add_wait_func,
+        .resize = resize_func,
+        .stats = stats_func,
+        .latency = latency_func,
+        .event_fd = event_fd_func,
+        .free = free_func,
+    };
+
+    if(RINGBUFFER_BLOCK == policy) {
+        buffer->public.add = add_block_func;
+        buffer->public.add_n = add_n_block_func;
+    }
+
+    return (Ringbuffer*)buffer;
+
+error:
+
+    return 0;
+}
+
+/******************************************************************************
+  PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static size_t capacity_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    return atomic_load_explicit(&internal->max_num_items, memory_order_relaxed);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Called by the producer.
+ * @return number of elements that might be added right now
+ */
+static inline size_t free_slots(InternalRingbuffer* internal, size_t write) {
+
+    size_t max_num_items =
+        atomic_load_explicit(&internal->max_num_items, memory_order_relaxed);
+
+    size_t num_items = write - internal->cached_next_to_read;
+
+    if(num_items >= max_num_items) {
+
+        internal->cached_next_to_read = atomic_load_explicit(
+                &internal->next_to_read, memory_order_acquire);
+
+        num_items = write - internal->cached_next_to_read;
+
+    }
+
+    return (num_items < max_num_items) ? max_num_items - num_items : 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Called by the consumer.
+ * Reloads next_to_write, but never beyond the end of the current segment.
+ * Moves on to the next segment if the current one is drained.
+ */
+static inline void reload_next_to_write(
+        InternalRingbuffer* internal, size_t read) {
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_acquire);
+
+    Segment* segment = internal->read_segment;
+    Segment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+
+    while(0 != next) {
+
+        if(read != segment->next_start) {
+
+            if(write - read > segment->next_start - read) {
+                write = segment->next_start;
+            }
+
+            break;
+
+        }
+
+        free(segment);
+        segment = next;
+        next = atomic_load_explicit(&segment->next, memory_order_acquire);
+
+    }
+
+    internal->read_segment = segment;
+    internal->cached_next_to_write = write;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_func(Ringbuffer* self, void* item) {
+
+    if(0 == self) goto error;
+    if(0 == item) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    if(0 == free_slots(internal, write)) {
+
+        if(waiter_rearm(&internal->not_full)) {
+            return add_func(self, item);
+        }
+
+        goto error;
+
+    }
+
+    Segment* segment = internal->write_segment;
+    segment->items[write & segment->index_mask] = item;
+
+    LATENCY_NOW(now);
+    LATENCY_STAMP(segment->timestamps[write & segment->index_mask], now);
+
+    atomic_store_explicit(
+            &internal->next_to_write, write + 1, memory_order_release);
+
+    STATS_ADD(&internal->add_stats.adds, 1);
+    STATS_WATERMARK(&internal->add_stats.high_watermark,
+            write + 1 - atomic_load_explicit(
+                &internal->next_to_read, memory_order_relaxed));
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_empty);
+    }
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    if(read == internal->cached_next_to_write) {
+
+        reload_next_to_write(internal, read);
+
+        if(read == internal->cached_next_to_write) {
+
+            if(waiter_rearm(&internal->not_empty)) {
+                return pop_func(self);
+            }
+
+            STATS_ADD(&internal->pop_stats.empty_pops, 1);
+            goto error;
+
+        }
+
+    }
+
+    Segment* segment = internal->read_segment;
+    void* retval = segment->items[read & segment->index_mask];
+
+    LATENCY_NOW(now);
+    LATENCY_RECORD(&internal->latency,
+            segment->timestamps[read & segment->index_mask], now);
+
+    atomic_store_explicit(
+            &internal->next_to_read, read + 1, memory_order_release);
+
+    STATS_ADD(&internal->pop_stats.pops, 1);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return retval;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    size_t available = free_slots(internal, write);
+
+    if((0 == available) && waiter_rearm(&internal->not_full)) {
+        return add_n_func(self, items, n);
+    }
+
+    if(n > available) {
+        n = available;
+    }
+
+    Segment* segment = internal->write_segment;
+
+    LATENCY_NOW(now);
+
+    for(size_t i = 0; i < n; ++i) {
+
+        if(0 == items[i]) {
+            n = i;
+            break;
+        }
+
+        segment->items[(write + i) & segment->index_mask] = items[i];
+        LATENCY_STAMP(
+                segment->timestamps[(write + i) & segment->index_mask], now);
+
+    }
+
+    atomic_store_explicit(
+            &internal->next_to_write, write + n, memory_order_release);
+
+    STATS_ADD(&internal->add_stats.adds, n);
+    STATS_WATERMARK(&internal->add_stats.high_watermark,
+            write + n - atomic_load_explicit(
+                &internal->next_to_read, memory_order_relaxed));
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_empty);
+    }
+
+    return n;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t pop_n_func(Ringbuffer* self, void** out, size_t max) {
+
+    if(0 == self) goto error;
+    if(0 == out) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+
+    size_t available = internal->cached_next_to_write - read;
+
+    if(available < max) {
+
+        reload_next_to_write(internal, read);
+        available = internal->cached_next_to_write - read;
+
+    }
+
+    if((0 == available) && waiter_rearm(&internal->not_empty)) {
+        return pop_n_func(self, out, max);
+    }
+
+    if(max > available) {
+        max = available;
+    }
+
+    Segment* segment = internal->read_segment;
+
+    LATENCY_NOW(now);
+
+    for(size_t i = 0; i < max; ++i) {
+        out[i] = segment->items[(read + i) & segment->index_mask];
+        LATENCY_RECORD(&internal->latency,
+                segment->timestamps[(read + i) & segment->index_mask], now);
+    }
+
+    atomic_store_explicit(
+            &internal->next_to_read, read + max, memory_order_release);
+
+    STATS_ADD(&internal->pop_stats.pops, max);
+
+    if(internal->waitable) {
+        waiter_notify(&internal->not_full);
+    }
+
+    return max;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* pop_wait_func(Ringbuffer* self, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) {
+        return pop_func(self);
+    }
+
+    return waiter_pop_wait(
+            &internal->not_empty, self, pop_func, timeout_usecs);
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_wait_func(
+        Ringbuffer* self, void* item, int64_t timeout_usecs) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) {
+        return add_func(self, item);
+    }
+
+    return waiter_add_wait(
+            &internal->not_full, self, add_func, item, timeout_usecs);
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool add_block_func(Ringbuffer* self, void* item) {
+
+    return add_wait_func(self, item, -1);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static size_t add_n_block_func(Ringbuffer* self, void** items, size_t n) {
+
+    if(0 == self) goto error;
+    if(0 == items) goto error;
+
+    size_t num_added = 0;
+
+    for(;;) {
+
+        num_added += add_n_func(self, items + num_added, n - num_added);
+
+        if((num_added == n) || (0 == items[num_added])) {
+            break;
+        }
+
+        if(! add_wait_func(self, items[num_added], -1)) {
+            break;
+        }
+
+        ++num_added;
+
+    }
+
+    return num_added;
+
+error:
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Called by the producer.
+ * If the current segment is too small, the producer continues in a new one.
+ */
+static bool resize_func(Ringbuffer* self, size_t new_capacity) {
+
+    if(0 == self) goto error;
+    if(0 == new_capacity) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    Segment* segment = internal->write_segment;
+
+    if(new_capacity > segment->index_mask + 1) {
+
+        Segment* next = segment_create(new_capacity);
+
+        if(0 == next) goto error;
+
+        segment->next_start =
+            atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+        atomic_store_explicit(&segment->next, next, memory_order_release);
+        internal->write_segment = next;
+
+    }
+
+    atomic_store_explicit(
+            &internal->max_num_items, new_capacity, memory_order_relaxed);
+
+    return true;
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool stats_func(Ringbuffer* self, RingbufferStats* stats) {
+
+    if(0 == self) goto error;
+    if(0 == stats) goto error;
+
+#if defined(RINGBUFFER_STATS)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    size_t read =
+        atomic_load_explicit(&internal->next_to_read, memory_order_relaxed);
+    size_t write =
+        atomic_load_explicit(&internal->next_to_write, memory_order_relaxed);
+
+    stats_get(stats, &internal->add_stats, &internal->pop_stats,
+            write - read);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool latency_func(
+        Ringbuffer* self, RingbufferLatency* latency, bool reset) {
+
+    if(0 == self) goto error;
+    if(0 == latency) goto error;
+
+#if defined(RINGBUFFER_LATENCY)
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    latency_get(&internal->latency, latency, reset);
+
+    return true;
+
+#endif
+
+error:
+
+    return false;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int event_fd_func(Ringbuffer* self, RingbufferEvent event) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(!internal->waitable) goto error;
+
+    switch(event) {
+
+        case RINGBUFFER_NOT_EMPTY:
+            return waiter_event_fd(&internal->not_empty);
+
+        case RINGBUFFER_NOT_FULL:
+            return waiter_event_fd(&internal->not_full);
+
+    }
+
+error:
+
+    return -1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* free_func(Ringbuffer* self) {
+
+    if(0 == self) goto error;
+
+    InternalRingbuffer* internal = (InternalRingbuffer*) self;
+
+    if(0 != internal->free_item) {
+
+        void* item = 0;
+
+        while(0 != (item = pop_func(self))) {
+            internal->free_item(item, internal->free_item_additional_arg);
+        }
+
+    }
+
+    Segment* segment = internal->read_segment;
+
+    while(0 != segment) {
+
+        Segment* next = atomic_load_explicit(&segment->next, memory_order_relaxed);
+        free(segment);
+        segment = next;
+
+    }
+
+    waiter_destroy(&internal->not_empty);
+    waiter_destroy(&internal->not_full);
+
+    free(self);
+    self = 0;
+
+error:
+
+    return self;
+
+}
+
+/*----------------------------------------------------------------------------*/
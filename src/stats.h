@@ -0,0 +1,157 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Private helpers to keep the counters behind Ringbuffer.stats.
+ * Unless RINGBUFFER_STATS is defined, the STATS_ macros expand to nothing,
+ * their arguments are not evaluated and the counters need not exist.
+ *
+ * Counters are relaxed atomics. Counters with a single writer are
+ * incremented by load/store, which compiles to plain instructions.
+ * Counters that might be written by several threads at once use
+ * STATS_ADD_SHARED / STATS_WATERMARK_SHARED.
+ */
+#ifndef __STATS_H__
+#define __STATS_H__
+/*----------------------------------------------------------------------------*/
+
+#include "../include/ringbuffer.h"
+#include <stdatomic.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Counters written on adding
+ */
+typedef struct {
+
+    atomic_size_t adds;
+    atomic_size_t overwrites;
+    atomic_size_t high_watermark;
+
+} AddStats;
+
+/**
+ * Counters written on popping
+ */
+typedef struct {
+
+    atomic_size_t pops;
+    atomic_size_t empty_pops;
+
+} PopStats;
+
+/*----------------------------------------------------------------------------*/
+
+static inline void stats_add(atomic_size_t* counter, size_t n) {
+
+    atomic_store_explicit(counter,
+            n + atomic_load_explicit(counter, memory_order_relaxed),
+            memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void stats_add_shared(atomic_size_t* counter, size_t n) {
+
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void stats_watermark(atomic_size_t* watermark, size_t num_items) {
+
+    if(num_items > atomic_load_explicit(watermark, memory_order_relaxed)) {
+        atomic_store_explicit(watermark, num_items, memory_order_relaxed);
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void stats_watermark_shared(
+        atomic_size_t* watermark, size_t num_items) {
+
+    size_t current = atomic_load_explicit(watermark, memory_order_relaxed);
+
+    while((num_items > current) && (! atomic_compare_exchange_weak_explicit(
+                    watermark, &current, num_items,
+                    memory_order_relaxed, memory_order_relaxed)));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void stats_get(RingbufferStats* out,
+        AddStats* add_stats, PopStats* pop_stats, size_t num_items) {
+
+    memset(out, 0, sizeof(RingbufferStats));
+
+    out->adds = atomic_load_explicit(&add_stats->adds, memory_order_relaxed);
+    out->overwrites =
+        atomic_load_explicit(&add_stats->overwrites, memory_order_relaxed);
+    out->high_watermark =
+        atomic_load_explicit(&add_stats->high_watermark, memory_order_relaxed);
+    out->pops = atomic_load_explicit(&pop_stats->pops, memory_order_relaxed);
+    out->empty_pops =
+        atomic_load_explicit(&pop_stats->empty_pops, memory_order_relaxed);
+    out->num_items = num_items;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#if defined(RINGBUFFER_STATS)
+
+#define STATS_ADD(counter, n) stats_add(counter, n)
+#define STATS_ADD_SHARED(counter, n) stats_add_shared(counter, n)
+#define STATS_WATERMARK(watermark, num_items) \
+    stats_watermark(watermark, num_items)
+#define STATS_WATERMARK_SHARED(watermark, num_items) \
+    stats_watermark_shared(watermark, num_items)
+
+#else
+
+#define STATS_ADD(counter, n)
+#define STATS_ADD_SHARED(counter, n)
+#define STATS_WATERMARK(watermark, num_items)
+#define STATS_WATERMARK_SHARED(watermark, num_items)
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,484 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Private helpers to let threads wait for a thread-safe Ringbuffer to become
+ * non-empty or non-full. Waiting threads spin briefly and park on a futex
+ * afterwards.
+ * The other side calls waiter_notify after each successful operation,
+ * which only issues a system call if there actually is a waiting thread.
+ *
+ * No wakeup is lost since both sides order their accesses with a seq_cst
+ * fence: a waiter announces itself, fences and checks the ringbuffer again,
+ * the other side completes its operation, fences and checks for waiters.
+ * At least one of them thus sees the other.
+ *
+ * Optionally, a waiter signals an eventfd, see waiter_event_fd.
+ * Once signalled, waiter_notify does not signal it again until the side
+ * waiting on it failed and called waiter_rearm, thus a burst of operations
+ * costs one write.
+ */
+#ifndef __WAITER_H__
+#define __WAITER_H__
+/*----------------------------------------------------------------------------*/
+
+#include "../include/ringbuffer.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <sched.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+#define WAITER_SPIN_COUNT 128
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    /* futex word, incremented on every wakeup */
+    atomic_uint sequence;
+    atomic_uint num_waiters;
+
+    /* eventfd or -1 */
+    atomic_int fd;
+    atomic_bool fd_signalled;
+
+} Waiter;
+
+/*----------------------------------------------------------------------------*/
+
+static inline void waiter_init(Waiter* waiter) {
+
+    atomic_init(&waiter->sequence, 0);
+    atomic_init(&waiter->num_waiters, 0);
+    atomic_init(&waiter->fd, -1);
+    atomic_init(&waiter->fd_signalled, false);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void waiter_destroy(Waiter* waiter) {
+
+    int fd = atomic_load_explicit(&waiter->fd, memory_order_relaxed);
+
+#if defined(__linux__)
+
+    if(0 <= fd) {
+        close(fd);
+    }
+
+#endif
+
+    atomic_store_explicit(&waiter->fd, -1, memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void waiter_pause(void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#if defined(__linux__)
+
+static inline void futex_wait(
+        atomic_uint* word, unsigned expected, struct timespec* timeout) {
+
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, timeout, 0, 0);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void futex_wake_all(atomic_uint* word) {
+
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+
+}
+
+#else
+
+static inline void futex_wait(
+        atomic_uint* word, unsigned expected, struct timespec* timeout) {
+
+    sched_yield();
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void futex_wake_all(atomic_uint* word) {
+
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Signal the eventfd unless it is signalled already.
+ */
+static inline void waiter_signal_fd(Waiter* waiter) {
+
+    int fd = atomic_load_explicit(&waiter->fd, memory_order_acquire);
+
+    if(0 > fd) {
+        return;
+    }
+
+    if(atomic_load_explicit(&waiter->fd_signalled, memory_order_relaxed)) {
+        return;
+    }
+
+    if(atomic_exchange_explicit(
+                &waiter->fd_signalled, true, memory_order_seq_cst)) {
+        return;
+    }
+
+#if defined(__linux__)
+    eventfd_write(fd, 1);
+#endif
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return the eventfd of this waiter, which is created if necessary,
+ *         -1 in case of failure
+ */
+static inline int waiter_event_fd(Waiter* waiter) {
+
+    int fd = atomic_load_explicit(&waiter->fd, memory_order_acquire);
+
+    if(0 <= fd) {
+        return fd;
+    }
+
+#if defined(__linux__)
+
+    int new_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(0 > new_fd) {
+        return -1;
+    }
+
+    if(! atomic_compare_exchange_strong_explicit(&waiter->fd, &fd, new_fd,
+                memory_order_acq_rel, memory_order_acquire)) {
+        close(new_fd);
+        return fd;
+    }
+
+    /* Operations that completed before the fd existed did not signal it.
+     * Signal it once, the waiting side will rearm it if it was in vain */
+    waiter_signal_fd(waiter);
+
+    return new_fd;
+
+#else
+
+    return -1;
+
+#endif
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * To be called if the operation the eventfd signals failed, i.e. pop found
+ * the ringbuffer empty or add found it full.
+ * @return true if the eventfd has been cleared, the failed operation must
+ *         be retried then, since the other side might have completed an
+ *         operation meanwhile without signalling
+ */
+static inline bool waiter_rearm(Waiter* waiter) {
+
+    if(! atomic_load_explicit(&waiter->fd_signalled, memory_order_acquire)) {
+        return false;
+    }
+
+#if defined(__linux__)
+
+    eventfd_t value = 0;
+    eventfd_read(
+            atomic_load_explicit(&waiter->fd, memory_order_relaxed), &value);
+
+#endif
+
+    atomic_store_explicit(&waiter->fd_signalled, false, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    return true;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * To be called after an element has been added / removed.
+ */
+static inline void waiter_notify(Waiter* waiter) {
+
+    /* Pairs with the fence in waiter_register / waiter_rearm */
+    atomic_thread_fence(memory_order_seq_cst);
+
+    waiter_signal_fd(waiter);
+
+    if(0 == atomic_load_explicit(&waiter->num_waiters, memory_order_relaxed)) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&waiter->sequence, 1, memory_order_seq_cst);
+    futex_wake_all(&waiter->sequence);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Announce that this thread is about to sleep.
+ * The ringbuffer must be checked again afterwards.
+ * @return sequence to hand to waiter_sleep
+ */
+static inline unsigned waiter_register(Waiter* waiter) {
+
+    unsigned sequence =
+        atomic_load_explicit(&waiter->sequence, memory_order_seq_cst);
+
+    atomic_fetch_add_explicit(&waiter->num_waiters, 1, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    return sequence;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void waiter_unregister(Waiter* waiter) {
+
+    atomic_fetch_sub_explicit(&waiter->num_waiters, 1, memory_order_relaxed);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @param deadline absolute CLOCK_MONOTONIC time, 0 to sleep without limit
+ * @return false if the deadline has passed
+ */
+static inline bool waiter_sleep(
+        Waiter* waiter, unsigned sequence, struct timespec* deadline) {
+
+    if(0 == deadline) {
+        futex_wait(&waiter->sequence, sequence, 0);
+        return true;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    struct timespec remaining = {
+        .tv_sec = deadline->tv_sec - now.tv_sec,
+        .tv_nsec = deadline->tv_nsec - now.tv_nsec,
+    };
+
+    if(0 > remaining.tv_nsec) {
+        remaining.tv_nsec += 1000 * 1000 * 1000;
+        --remaining.tv_sec;
+    }
+
+    if(0 > remaining.tv_sec) {
+        return false;
+    }
+
+    futex_wait(&waiter->sequence, sequence, &remaining);
+
+    return true;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return deadline or 0 if timeout_usecs is negative, i.e. infinite
+ */
+static inline struct timespec* waiter_deadline(
+        struct timespec* deadline, int64_t timeout_usecs) {
+
+    if(0 > timeout_usecs) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+
+    deadline->tv_sec += timeout_usecs / (1000 * 1000);
+    deadline->tv_nsec += (timeout_usecs % (1000 * 1000)) * 1000;
+
+    if(1000 * 1000 * 1000 <= deadline->tv_nsec) {
+        deadline->tv_nsec -= 1000 * 1000 * 1000;
+        ++deadline->tv_sec;
+    }
+
+    return deadline;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Repeatedly tries pop until it succeeds or timeout_usecs passed.
+ */
+static inline void* waiter_pop_wait(
+        Waiter* not_empty,
+        Ringbuffer* self,
+        void* (*pop)(Ringbuffer*),
+        int64_t timeout_usecs) {
+
+    void* item = pop(self);
+
+    if((0 != item) || (0 == timeout_usecs)) {
+        return item;
+    }
+
+    for(size_t i = 0; i < WAITER_SPIN_COUNT; ++i) {
+
+        waiter_pause();
+        item = pop(self);
+
+        if(0 != item) {
+            return item;
+        }
+
+    }
+
+    struct timespec deadline_buffer;
+    struct timespec* deadline = waiter_deadline(&deadline_buffer, timeout_usecs);
+
+    for(;;) {
+
+        unsigned sequence = waiter_register(not_empty);
+
+        item = pop(self);
+
+        bool timed_out =
+            (0 == item) && (! waiter_sleep(not_empty, sequence, deadline));
+
+        waiter_unregister(not_empty);
+
+        if((0 != item) || timed_out) {
+            break;
+        }
+
+    }
+
+    return item;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Repeatedly tries add until it succeeds or timeout_usecs passed.
+ */
+static inline bool waiter_add_wait(
+        Waiter* not_full,
+        Ringbuffer* self,
+        bool (*add)(Ringbuffer*, void*),
+        void* item,
+        int64_t timeout_usecs) {
+
+    if(0 == item) {
+        return false;
+    }
+
+    bool added = add(self, item);
+
+    if(added || (0 == timeout_usecs)) {
+        return added;
+    }
+
+    for(size_t i = 0; i < WAITER_SPIN_COUNT; ++i) {
+
+        waiter_pause();
+
+        if(add(self, item)) {
+            return true;
+        }
+
+    }
+
+    struct timespec deadline_buffer;
+    struct timespec* deadline = waiter_deadline(&deadline_buffer, timeout_usecs);
+
+    for(;;) {
+
+        unsigned sequence = waiter_register(not_full);
+
+        added = add(self, item);
+
+        bool timed_out =
+            (! added) && (! waiter_sleep(not_full, sequence, deadline));
+
+        waiter_unregister(not_full);
+
+        if(added || timed_out) {
+            break;
+        }
+
+    }
+
+    return added;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "test_helper.h"
+#include "../src/array_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+
+/*----------------------------------------------------------------------------*/
+
+void test_array_ringbuffer_create() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == array_ringbuffer_create(0, 0, 0));
+
+    buffer = array_ringbuffer_create(1, 0, 0);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(add_func == buffer->add);
+    assert(pop_func == buffer->pop);
+    assert(free_func == buffer->free);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "array_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void count_free(void* int_pointer, void* count) {
+
+    int* ip = (int*) int_pointer;
+    free(ip);
+    size_t* c = (size_t*) count;
+    *c = *c + 1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_wrap_around() {
+
+    int items[100];
+
+    /* 16 is wrapped by masking, 13 by comparison */
+    size_t capacities[] = {16, 13};
+
+    for(size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); ++c) {
+
+        Ringbuffer* buffer = array_ringbuffer_create(capacities[c], 0, 0);
+        const size_t capacity = buffer->capacity(buffer);
+
+        for(size_t i = 0; i < 100; ++i) {
+            assert(buffer->add(buffer, items + i));
+        }
+
+        for(size_t i = 100 - capacity; i < 100; ++i) {
+            assert(items + i == buffer->pop(buffer));
+        }
+
+        assert(0 == buffer->pop(buffer));
+
+        buffer = buffer->free(buffer);
+
+    }
+
+    fprintf(stdout, "wrap around OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_add_n_wrap_around() {
+
+    int a[30];
+    void* items[30];
+    void* out[30];
+
+    for(size_t i = 0; i < 30; ++i) {
+        items[i] = a + i;
+    }
+
+    Ringbuffer* buffer = array_ringbuffer_create(13, 0, 0);
+
+    assert(10 == buffer->add_n(buffer, items, 10));
+    assert(10 == buffer->pop_n(buffer, out, 10));
+
+    /* Wraps around the end of the array */
+    assert(10 == buffer->add_n(buffer, items, 10));
+    assert(10 == buffer->pop_n(buffer, out, 30));
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(items[i] == out[i]);
+    }
+
+    /* Overwrites the oldest elements */
+    assert(5 == buffer->add_n(buffer, items, 5));
+    assert(30 == buffer->add_n(buffer, items, 30));
+    assert(13 == buffer->pop_n(buffer, out, 30));
+
+    for(size_t i = 0; i < 13; ++i) {
+        assert(items[17 + i] == out[i]);
+    }
+
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "add_n()/pop_n() wrap around OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_free() {
+
+    int a = 1;
+
+    Ringbuffer* buffer = 0;
+    assert(0 == free_func(0));
+
+    buffer = array_ringbuffer_create(21, 0, 0);
+    for(size_t i = 0; i < buffer->capacity(buffer); ++i) {
+        buffer->add(buffer, &a);
+    }
+    assert(0 == buffer->free(buffer));
+
+    size_t count = 0;
+    buffer = array_ringbuffer_create(21, count_free, &count);
+    for(size_t i = 0; i < 2 * buffer->capacity(buffer); ++i) {
+        int* ip = calloc(1, sizeof(int));
+        *ip = i;
+        buffer->add(buffer, ip);
+    }
+    assert(21 == count);
+    free(buffer->pop(buffer));
+    assert(0 == buffer->free(buffer));
+    assert(41 == count);
+
+    fprintf(stdout, "free() OK\n");
+
+}
+
+void test_array_ringbuffer_create_with_policy() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == array_ringbuffer_create_with_policy(
+                0, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == array_ringbuffer_create_with_policy(
+                1, RINGBUFFER_BLOCK, 0, 0));
+
+    buffer = array_ringbuffer_create_with_policy(1, RINGBUFFER_OVERWRITE, 0, 0);
+    assert(add_func == buffer->add);
+    assert(add_n_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    buffer = array_ringbuffer_create_with_policy(1, RINGBUFFER_REJECT, 0, 0);
+    assert(add_reject_func == buffer->add);
+    assert(add_n_reject_func == buffer->add_n);
+    assert(add_wait_reject_func == buffer->add_wait);
+    buffer = buffer->free(buffer);
+
+    test_reject_policy(array_ringbuffer_create_with_policy);
+
+    fprintf(stdout, "array_ringbuffer_create_with_policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_overwrite_stats() {
+
+#if defined(RINGBUFFER_STATS)
+
+    int a[10];
+    RingbufferStats stats;
+
+    Ringbuffer* buffer = array_ringbuffer_create(3, 0, 0);
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(buffer->resize(buffer, 2));
+
+    assert(buffer->stats(buffer, &stats));
+    assert(10 == stats.adds);
+    assert(8 == stats.overwrites);
+    assert(2 == stats.num_items);
+    assert(3 == stats.high_watermark);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "overwrite stats OK\n");
+
+#endif
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    create = array_ringbuffer_create;
+
+    test_ringbuffer_create();
+    test_capacity();
+    test_add();
+    test_pop();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_resize();
+    test_array_ringbuffer_create();
+    test_wrap_around();
+    test_add_n_wrap_around();
+    test_free();
+    test_array_ringbuffer_create_with_policy();
+    test_overwrite_stats();
+
+}
+
+/*----------------------------------------------------------------------------*/
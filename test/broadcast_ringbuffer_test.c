@@ -0,0 +1,303 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#include "../src/broadcast_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*----------------------------------------------------------------------------*/
+
+static size_t num_freed = 0;
+
+static void count_free(void* item, void* arg) {
+
+    ++num_freed;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_broadcast_ringbuffer_create() {
+
+    BroadcastRingbuffer* buffer = 0;
+
+    assert(0 == broadcast_ringbuffer_create(0, 1, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == broadcast_ringbuffer_create(1, 0, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == broadcast_ringbuffer_create(
+                1, 1, RINGBUFFER_OVERWRITE, count_free, 0));
+    assert(0 == broadcast_ringbuffer_create(1, 1, 42, 0, 0));
+
+    buffer = broadcast_ringbuffer_create(3, 2, RINGBUFFER_REJECT, 0, 0);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(num_readers_func == buffer->num_readers);
+    assert(add_func == buffer->add);
+    assert(peek_func == buffer->peek);
+    assert(release_func == buffer->release);
+    assert(free_func == buffer->free);
+    assert(4 == buffer->capacity(buffer));
+    assert(2 == buffer->num_readers(buffer));
+    buffer = buffer->free(buffer);
+    assert(0 == buffer);
+
+    buffer = broadcast_ringbuffer_create(4, 1, RINGBUFFER_BLOCK, 0, 0);
+    assert(add_block_func == buffer->add);
+    buffer = buffer->free(buffer);
+
+    buffer = broadcast_ringbuffer_create(4, 1, RINGBUFFER_OVERWRITE, 0, 0);
+    assert(add_overwrite_func == buffer->add);
+    assert(peek_overwrite_func == buffer->peek);
+    buffer = buffer->free(buffer);
+
+    assert(0 == free_func(0));
+
+    fprintf(stdout, "broadcast_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_reject_policy() {
+
+    uintptr_t i = 0;
+
+    BroadcastRingbuffer* buffer =
+        broadcast_ringbuffer_create(4, 2, RINGBUFFER_REJECT, count_free, 0);
+
+    assert(! buffer->add(buffer, 0));
+    assert(0 == buffer->peek(buffer, 0));
+    assert(0 == buffer->peek(buffer, 2));
+    assert(! buffer->release(buffer, 0));
+    assert(! buffer->release(buffer, 2));
+
+    for(i = 1; i <= 4; ++i) {
+        assert(buffer->add(buffer, (void*) i));
+    }
+
+    assert(! buffer->add(buffer, (void*) 5));
+
+    /* Only RINGBUFFER_BLOCK wakes a producer - fake one waiting */
+    InternalRingbuffer* internal = (InternalRingbuffer*) buffer;
+    assert(! internal->waitable);
+    atomic_store(&internal->not_full.num_waiters, 1);
+
+    /* Both readers see all elements */
+    for(i = 1; i <= 4; ++i) {
+        assert(i == (uintptr_t) buffer->peek(buffer, 0));
+        assert(i == (uintptr_t) buffer->peek(buffer, 0));
+        assert(buffer->release(buffer, 0));
+    }
+
+    assert(0 == buffer->peek(buffer, 0));
+    assert(! buffer->release(buffer, 0));
+
+    assert(0 == atomic_load(&internal->not_full.sequence));
+    atomic_store(&internal->not_full.num_waiters, 0);
+
+    /* Reader 1 is the slowest one and gates the producer */
+    assert(! buffer->add(buffer, (void*) 5));
+
+    assert(1 == (uintptr_t) buffer->peek(buffer, 1));
+    assert(buffer->release(buffer, 1));
+
+    num_freed = 0;
+    assert(buffer->add(buffer, (void*) 5));
+    assert(1 == num_freed);
+    assert(! buffer->add(buffer, (void*) 6));
+
+    assert(5 == (uintptr_t) buffer->peek(buffer, 0));
+
+    for(i = 2; i <= 5; ++i) {
+        assert(i == (uintptr_t) buffer->peek(buffer, 1));
+        assert(buffer->release(buffer, 1));
+    }
+
+    num_freed = 0;
+    buffer = buffer->free(buffer);
+    assert(4 == num_freed);
+
+    fprintf(stdout, "reject policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_overwrite_policy() {
+
+    uintptr_t i = 0;
+
+    BroadcastRingbuffer* buffer =
+        broadcast_ringbuffer_create(4, 2, RINGBUFFER_OVERWRITE, 0, 0);
+
+    for(i = 1; i <= 3; ++i) {
+        assert(buffer->add(buffer, (void*) i));
+    }
+
+    assert(1 == (uintptr_t) buffer->peek(buffer, 0));
+    assert(buffer->release(buffer, 0));
+
+    for(i = 4; i <= 10; ++i) {
+        assert(buffer->add(buffer, (void*) i));
+    }
+
+    /* Both readers lost elements and continue with the oldest one left */
+    for(i = 7; i <= 10; ++i) {
+        assert(i == (uintptr_t) buffer->peek(buffer, 0));
+        assert(buffer->release(buffer, 0));
+        assert(i == (uintptr_t) buffer->peek(buffer, 1));
+        assert(buffer->release(buffer, 1));
+    }
+
+    assert(0 == buffer->peek(buffer, 0));
+    assert(0 == buffer->peek(buffer, 1));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "overwrite policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const uintptr_t NUM_TRANSFERS = 200 * 1000;
+
+#define NUM_READERS 3
+
+typedef struct {
+
+    BroadcastRingbuffer* buffer;
+    size_t reader;
+    bool may_lose;
+
+} ReaderArg;
+
+/*----------------------------------------------------------------------------*/
+
+static void* reader(void* arg) {
+
+    ReaderArg* reader_arg = arg;
+    BroadcastRingbuffer* buffer = reader_arg->buffer;
+
+    uintptr_t last = 0;
+
+    while(last < NUM_TRANSFERS) {
+
+        void* item = buffer->peek(buffer, reader_arg->reader);
+
+        if(0 == item) {
+            sched_yield();
+            continue;
+        }
+
+        if(reader_arg->may_lose) {
+            assert(last < (uintptr_t) item);
+        } else {
+            assert(last + 1 == (uintptr_t) item);
+        }
+
+        last = (uintptr_t) item;
+        assert(buffer->release(buffer, reader_arg->reader));
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void concurrent_transfer(RingbufferPolicy policy) {
+
+    BroadcastRingbuffer* buffer =
+        broadcast_ringbuffer_create(64, NUM_READERS, policy, 0, 0);
+
+    pthread_t threads[NUM_READERS];
+    ReaderArg args[NUM_READERS];
+
+    for(size_t i = 0; i < NUM_READERS; ++i) {
+
+        args[i] = (ReaderArg) {
+            .buffer = buffer,
+            .reader = i,
+            .may_lose = (RINGBUFFER_OVERWRITE == policy),
+        };
+
+        assert(0 == pthread_create(threads + i, 0, reader, args + i));
+
+    }
+
+    for(uintptr_t i = 1; i <= NUM_TRANSFERS; ++i) {
+
+        while(! buffer->add(buffer, (void*) i)) {
+            sched_yield();
+        }
+
+    }
+
+    for(size_t i = 0; i < NUM_READERS; ++i) {
+        assert(0 == pthread_join(threads[i], 0));
+    }
+
+    buffer = buffer->free(buffer);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_transfer() {
+
+    concurrent_transfer(RINGBUFFER_REJECT);
+    concurrent_transfer(RINGBUFFER_BLOCK);
+    concurrent_transfer(RINGBUFFER_OVERWRITE);
+
+    fprintf(stdout, "concurrent transfer OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_broadcast_ringbuffer_create();
+    test_reject_policy();
+    test_overwrite_policy();
+    test_concurrent_transfer();
+
+}
+
+/*----------------------------------------------------------------------------*/
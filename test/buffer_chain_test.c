@@ -0,0 +1,178 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "../include/ringbuffer.h"
+#include "../src/buffer_chain.c"
+#include <stdio.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+
+static void fill(uint8_t* data, size_t num_bytes, uint8_t first) {
+
+    for(size_t i = 0; i < num_bytes; ++i) {
+        data[i] = (uint8_t) (first + i);
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffer_chain_create() {
+
+    Ringbuffer* cache = buffercache_create(4);
+
+    assert(0 == buffer_chain_create(cache, 0));
+
+    BufferChain* chain = buffer_chain_create(cache, 16);
+    assert(chain);
+    assert(append_func == chain->append);
+    assert(0 == chain->length(chain));
+
+    struct iovec iov[1];
+    assert(0 == chain->iovec(chain, iov, 1));
+
+    assert(0 == chain->append(chain, 0, 10));
+    assert(0 == chain->free(chain));
+
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Create ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffer_chain_append() {
+
+    Ringbuffer* cache = buffercache_create(8);
+    BufferChain* chain = buffer_chain_create(cache, 16);
+
+    uint8_t data[100];
+    fill(data, sizeof(data), 1);
+
+    /* Fills up the last segment before adding another one */
+    assert(10 == chain->append(chain, data, 10));
+    assert(60 == chain->append(chain, data + 10, 60));
+    assert(70 == chain->length(chain));
+
+    struct iovec iov[8];
+    assert(5 == chain->iovec(chain, iov, 8));
+
+    size_t offset = 0;
+
+    for(size_t i = 0; i < 5; ++i) {
+        assert((4 == i) ? (6 == iov[i].iov_len) : (16 == iov[i].iov_len));
+        assert(0 == memcmp(data + offset, iov[i].iov_base, iov[i].iov_len));
+        offset += iov[i].iov_len;
+    }
+
+    assert(2 == chain->iovec(chain, iov, 2));
+
+    /* All segments go back to the cache at once */
+    void* segments[5] = {0};
+
+    chain->release(chain);
+    assert(0 == chain->length(chain));
+    assert(0 == chain->iovec(chain, iov, 8));
+    assert(5 == cache->pop_n(cache, segments, 5));
+
+    for(size_t i = 0; i < 5; ++i) {
+        assert(16 == ((Buffer*) segments[i])->capacity_bytes);
+        assert(0 == ((Buffer*) segments[i])->bytes_used);
+        assert(buffercache_release_buffer(cache, segments[i]));
+    }
+
+    /* Reusable after release, segments come from the cache */
+    assert(100 == chain->append(chain, data, 100));
+    assert(100 == chain->length(chain));
+    assert(0 == cache->pop(cache));
+
+    assert(0 == chain->free(chain));
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Append ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffer_chain_writev() {
+
+    int fds[2];
+    assert(0 == pipe2(fds, O_NONBLOCK));
+
+    BufferChain* chain = buffer_chain_create(0, 100);
+
+    uint8_t data[1000];
+    fill(data, sizeof(data), 7);
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(100 == chain->append(chain, data + 100 * i, 100));
+    }
+
+    struct iovec iov[10];
+    assert(10 == chain->iovec(chain, iov, 10));
+    assert(1000 == writev(fds[1], iov, 10));
+
+    uint8_t received[1000];
+    assert(1000 == read(fds[0], received, sizeof(received)));
+    assert(0 == memcmp(data, received, sizeof(data)));
+
+    /* Without cache, segments are freed */
+    assert(0 == chain->free(chain));
+
+    close(fds[0]);
+    close(fds[1]);
+
+    fprintf(stdout, "Writev ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_buffer_chain_create();
+    test_buffer_chain_append();
+    test_buffer_chain_writev();
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,196 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#include "../src/buffer_depot.c"
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+/*----------------------------------------------------------------------------*/
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 10000
+
+/*----------------------------------------------------------------------------*/
+
+static void test_buffer_depot_create() {
+
+    assert(0 == buffer_depot_create(0, 4));
+
+    BufferDepot* depot = buffer_depot_create(4, 0);
+    assert(0 != depot);
+    assert(0 == depot->create_cache(0));
+    assert(0 == depot->free(depot));
+
+    fprintf(stdout, "Create ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void test_buffer_depot_exchange() {
+
+    BufferDepot* depot = buffer_depot_create(4, 2);
+
+    Ringbuffer* producer = depot->create_cache(depot);
+    Ringbuffer* consumer = depot->create_cache(depot);
+    assert(8 == producer->capacity(producer));
+    assert(! producer->resize(producer, 100));
+
+    Buffer* buffers[20] = {0};
+
+    for(size_t i = 0; i < 20; ++i) {
+        buffers[i] = buffercache_get_buffer(producer, 10);
+        assert(0 != buffers[i]);
+    }
+
+    /* The first 8 go to the depot, 8 remain in the producer, 4 are freed */
+    for(size_t i = 0; i < 20; ++i) {
+        assert(buffercache_release_buffer(producer, buffers[i]));
+    }
+
+#if defined(RINGBUFFER_STATS)
+    RingbufferStats stats;
+    assert(producer->stats(producer, &stats));
+    assert(20 == stats.cache_misses);
+    assert(20 == stats.adds);
+    assert(4 == stats.overwrites);
+    assert(8 == stats.num_items);
+#endif
+
+    /* The consumer takes the magazines from the depot */
+    Buffer* received[9] = {0};
+
+    for(size_t i = 0; i < 8; ++i) {
+
+        received[i] = buffercache_get_buffer(consumer, 10);
+
+        bool found = false;
+
+        for(size_t j = 0; j < 8; ++j) {
+            found |= (received[i] == buffers[j]);
+        }
+
+        assert(found);
+
+    }
+
+    /* The depot is empty now */
+    received[8] = buffercache_get_buffer(consumer, 10);
+    assert(0 != received[8]);
+
+    for(size_t i = 0; i < 9; ++i) {
+        assert(buffercache_release_buffer(consumer, received[i]));
+    }
+
+#if defined(RINGBUFFER_STATS)
+    assert(consumer->stats(consumer, &stats));
+    assert(8 == stats.cache_hits);
+    assert(1 == stats.cache_misses);
+#endif
+
+    /* Returns the magazines to the depot */
+    assert(0 == producer->free(producer));
+    assert(0 == consumer->free(consumer));
+
+    assert(0 == depot->free(depot));
+
+    fprintf(stdout, "Exchange ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* churn(void* arg) {
+
+    BufferDepot* depot = arg;
+    Ringbuffer* cache = depot->create_cache(depot);
+    Buffer* buffers[20] = {0};
+
+    for(size_t round = 0; round < NUM_ROUNDS; ++round) {
+
+        size_t n = 1 + round % 20;
+
+        for(size_t i = 0; i < n; ++i) {
+            buffers[i] = buffercache_get_buffer(cache, 10);
+            assert(0 != buffers[i]);
+            buffers[i]->data[0] = (uint8_t) i;
+        }
+
+        for(size_t i = 0; i < n; ++i) {
+            assert(i == buffers[i]->data[0]);
+            assert(buffercache_release_buffer(cache, buffers[i]));
+        }
+
+    }
+
+    assert(0 == cache->free(cache));
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void test_buffer_depot_concurrent() {
+
+    BufferDepot* depot = buffer_depot_create(4, 8);
+    pthread_t threads[NUM_THREADS];
+
+    for(size_t i = 0; i < NUM_THREADS; ++i) {
+        assert(0 == pthread_create(threads + i, 0, churn, depot));
+    }
+
+    for(size_t i = 0; i < NUM_THREADS; ++i) {
+        assert(0 == pthread_join(threads[i], 0));
+    }
+
+    assert(0 == depot->free(depot));
+
+    fprintf(stdout, "Concurrent ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_buffer_depot_create();
+    test_buffer_depot_exchange();
+    test_buffer_depot_concurrent();
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,267 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "../include/ringbuffer.h"
+#include "../src/buffer_drain.c"
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+
+static void free_buffer(void* buffer, void* additional_arg) {
+
+    buffercache_free_buffers(&buffer, 1, additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @return a Buffer holding num_bytes bytes, counting up from first
+ */
+static Buffer* create_buffer(size_t num_bytes, uint8_t first) {
+
+    Buffer* buffer = calloc(1, sizeof(Buffer));
+    assert(0 != buffer);
+
+    buffer->data = calloc(1, num_bytes + 1);
+    assert(0 != buffer->data);
+
+    buffer->capacity_bytes = num_bytes + 1;
+    buffer->bytes_used = num_bytes;
+
+    for(size_t i = 0; i < num_bytes; ++i) {
+        buffer->data[i] = (uint8_t) (first + i);
+    }
+
+    return buffer;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Reads num_bytes from fd and checks they count up from *next.
+ */
+static void read_and_check(int fd, size_t num_bytes, uint8_t* next) {
+
+    uint8_t data[4096];
+
+    while(0 < num_bytes) {
+
+        size_t to_read = (sizeof(data) < num_bytes) ? sizeof(data) : num_bytes;
+        ssize_t num_read = read(fd, data, to_read);
+
+        assert(0 < num_read);
+
+        for(ssize_t i = 0; i < num_read; ++i) {
+            assert(*next == data[i]);
+            ++*next;
+        }
+
+        num_bytes -= num_read;
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffer_drain_create() {
+
+    Ringbuffer* ring = ringbuffer_create(4, free_buffer, 0);
+    Ringbuffer* cache = buffercache_create(4);
+
+    assert(0 == buffer_drain_create(0, cache, 4));
+    assert(0 == buffer_drain_create(ring, cache, 0));
+    assert(0 == buffer_drain_create(ring, cache, IOV_MAX + 1));
+
+    BufferDrain* drain = buffer_drain_create(ring, cache, 4);
+    assert(drain);
+    assert(drain_func == drain->drain);
+    assert(0 == drain->pending(drain));
+    assert(0 == drain->free(drain));
+
+    drain = buffer_drain_create(ring, 0, IOV_MAX);
+    assert(drain);
+    assert(0 == drain->free(drain));
+
+    assert(-1 == drain_func(0, 1));
+    assert(0 == pending_func(0));
+    assert(0 == free_func(0));
+
+    ring = ring->free(ring);
+    cache = cache->free(cache);
+
+    fprintf(stdout, "buffer_drain_create() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_drain() {
+
+    int fds[2];
+    assert(0 == pipe(fds));
+
+    Ringbuffer* ring = ringbuffer_create(8, free_buffer, 0);
+    Ringbuffer* cache = buffercache_create(8);
+
+    BufferDrain* drain = buffer_drain_create(ring, cache, 3);
+
+    assert(0 == drain->drain(drain, fds[1]));
+
+    uint8_t next = 0;
+    uint8_t expected = 0;
+
+    for(size_t i = 1; i <= 5; ++i) {
+        assert(ring->add(ring, create_buffer(i, next)));
+        next += i;
+    }
+
+    /* Empty buffers are released without writing anything */
+    assert(ring->add(ring, create_buffer(0, next)));
+
+    /* At most max_buffers at once */
+    assert(1 + 2 + 3 == drain->drain(drain, fds[1]));
+    assert(0 == drain->pending(drain));
+    read_and_check(fds[0], 1 + 2 + 3, &expected);
+
+    assert(4 + 5 == drain->drain(drain, fds[1]));
+    read_and_check(fds[0], 4 + 5, &expected);
+
+    RingbufferStats stats;
+
+    if(cache->stats(cache, &stats)) {
+        assert(6 == stats.num_items);
+    }
+
+    assert(0 == drain->drain(drain, fds[1]));
+    assert(0 == ring->pop(ring));
+
+    drain = drain->free(drain);
+    ring = ring->free(ring);
+    cache = cache->free(cache);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    fprintf(stdout, "drain() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_partial_drain() {
+
+    int fds[2];
+    assert(0 == pipe2(fds, O_NONBLOCK));
+
+    int pipe_size = fcntl(fds[1], F_SETPIPE_SZ, 4096);
+    assert(4096 <= pipe_size);
+
+    Ringbuffer* ring = ringbuffer_create(8, free_buffer, 0);
+    BufferDrain* drain = buffer_drain_create(ring, 0, 8);
+
+    const size_t buffer_size = 3 * pipe_size / 4;
+
+    uint8_t next = 0;
+    uint8_t expected = 0;
+
+    for(size_t i = 0; i < 4; ++i) {
+        assert(ring->add(ring, create_buffer(buffer_size, next)));
+        next += buffer_size;
+    }
+
+    /* Pipe fills up in the middle of the second buffer */
+    ssize_t written = drain->drain(drain, fds[1]);
+    assert(0 < written);
+    assert((size_t) written < 4 * buffer_size);
+    assert(4 * buffer_size - written == drain->pending(drain));
+
+    assert(-1 == drain->drain(drain, fds[1]));
+    assert(EAGAIN == errno);
+    assert(4 * buffer_size - written == drain->pending(drain));
+
+    size_t total = written;
+
+    while(total < 4 * buffer_size) {
+
+        read_and_check(fds[0], written, &expected);
+
+        written = drain->drain(drain, fds[1]);
+        assert(0 < written);
+
+        total += written;
+
+    }
+
+    read_and_check(fds[0], written, &expected);
+    assert(next == expected);
+
+    assert(0 == drain->pending(drain));
+    assert(0 == drain->drain(drain, fds[1]));
+
+    /* Pending buffers are released on free */
+    assert(ring->add(ring, create_buffer(2 * pipe_size, 0)));
+    assert(pipe_size == drain->drain(drain, fds[1]));
+    assert(pipe_size == drain->pending(drain));
+
+    drain = drain->free(drain);
+    ring = ring->free(ring);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    fprintf(stdout, "partial drain OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_buffer_drain_create();
+    test_drain();
+    test_partial_drain();
+
+}
+
+/*----------------------------------------------------------------------------*/
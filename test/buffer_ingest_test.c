@@ -0,0 +1,240 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "../include/ringbuffer.h"
+#include "../src/buffer_ingest.c"
+#include <stdio.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------*/
+
+static void free_buffer(void* buffer, void* additional_arg) {
+
+    buffercache_free_buffers(&buffer, 1, additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Pops num_buffers Buffer s from ring, checks their content counts up
+ * from *next and releases them to cache.
+ */
+static void pop_and_check(Ringbuffer* ring, Ringbuffer* cache,
+        size_t num_buffers, size_t bytes_per_buffer, uint8_t* next) {
+
+    for(size_t i = 0; i < num_buffers; ++i) {
+
+        Buffer* buffer = ring->pop(ring);
+
+        assert(0 != buffer);
+        assert(bytes_per_buffer == buffer->bytes_used);
+
+        for(size_t b = 0; b < buffer->bytes_used; ++b) {
+            assert(*next == buffer->data[b]);
+            ++*next;
+        }
+
+        buffercache_release_buffer(cache, buffer);
+
+    }
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffer_ingest_create() {
+
+    Ringbuffer* ring = ringbuffer_create(4, free_buffer, 0);
+    Ringbuffer* cache = buffercache_create(4);
+
+    assert(0 == buffer_ingest_create(cache, 0, 4, 16));
+    assert(0 == buffer_ingest_create(cache, ring, 0, 16));
+    assert(0 == buffer_ingest_create(cache, ring, IOV_MAX + 1, 16));
+    assert(0 == buffer_ingest_create(cache, ring, 4, 0));
+
+    BufferIngest* ingest = buffer_ingest_create(cache, ring, 4, 16);
+    assert(ingest);
+    assert(read_func == ingest->read);
+    assert(0 == ingest->pending(ingest));
+    assert(0 == ingest->free(ingest));
+
+    ingest = buffer_ingest_create(0, ring, IOV_MAX, 16);
+    assert(ingest);
+    assert(0 == ingest->free(ingest));
+
+    assert(-1 == read_func(0, 0));
+    assert(-1 == receive_func(0, 0));
+    assert(0 == pending_func(0));
+    assert(0 == free_func(0));
+
+    ring = ring->free(ring);
+    cache = cache->free(cache);
+
+    fprintf(stdout, "buffer_ingest_create() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_read() {
+
+    int fds[2];
+    assert(0 == pipe2(fds, O_NONBLOCK));
+
+    Ringbuffer* ring = ringbuffer_create_with_policy(
+            4, RINGBUFFER_REJECT, free_buffer, 0);
+    Ringbuffer* cache = buffercache_create(8);
+
+    BufferIngest* ingest = buffer_ingest_create(cache, ring, 3, 16);
+
+    assert(-1 == ingest->read(ingest, fds[0]));
+    assert(EAGAIN == errno);
+    assert(0 == ring->pop(ring));
+
+    uint8_t data[100];
+
+    for(size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    assert(sizeof(data) == write(fds[1], data, sizeof(data)));
+
+    /* At most 3 buffers at once */
+    assert(3 * 16 == ingest->read(ingest, fds[0]));
+    assert(0 == ingest->pending(ingest));
+
+    /* Ring accepts 1 more buffer only */
+    assert(3 * 16 == ingest->read(ingest, fds[0]));
+    assert(2 == ingest->pending(ingest));
+
+    assert(-1 == ingest->read(ingest, fds[0]));
+    assert(ENOBUFS == errno);
+
+    uint8_t next = 0;
+    pop_and_check(ring, cache, 4, 16, &next);
+
+    /* Pending buffers are added first, the remaining 4 bytes fill
+     * 1 buffer, the other 2 unused buffers go back to the cache */
+    assert(4 == ingest->read(ingest, fds[0]));
+    assert(0 == ingest->pending(ingest));
+
+    pop_and_check(ring, cache, 2, 16, &next);
+    pop_and_check(ring, cache, 1, 4, &next);
+    assert(sizeof(data) == next);
+    assert(0 == ring->pop(ring));
+
+    RingbufferStats stats;
+
+    if(cache->stats(cache, &stats)) {
+        assert(6 == stats.num_items);
+    }
+
+    close(fds[1]);
+    assert(0 == ingest->read(ingest, fds[0]));
+    assert(0 == ring->pop(ring));
+
+    ingest = ingest->free(ingest);
+    ring = ring->free(ring);
+    cache = cache->free(cache);
+
+    close(fds[0]);
+
+    fprintf(stdout, "read() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_receive() {
+
+    int fds[2];
+    assert(0 == socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds));
+
+    Ringbuffer* ring = ringbuffer_create(8, free_buffer, 0);
+    Ringbuffer* cache = buffercache_create(8);
+
+    BufferIngest* ingest = buffer_ingest_create(cache, ring, 4, 16);
+
+    assert(-1 == ingest->receive(ingest, fds[0]));
+    assert(EAGAIN == errno);
+
+    uint8_t data[20];
+
+    for(size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    assert(3 == send(fds[1], data, 3, 0));
+    assert(5 == send(fds[1], data + 3, 5, 0));
+    assert(20 == send(fds[1], data, 20, 0));
+
+    assert(3 == ingest->receive(ingest, fds[0]));
+
+    uint8_t next = 0;
+    pop_and_check(ring, cache, 1, 3, &next);
+    pop_and_check(ring, cache, 1, 5, &next);
+
+    /* Truncated to the buffer size */
+    next = 0;
+    pop_and_check(ring, cache, 1, 16, &next);
+    assert(0 == ring->pop(ring));
+
+    ingest = ingest->free(ingest);
+    ring = ring->free(ring);
+    cache = cache->free(cache);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    fprintf(stdout, "receive() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_buffer_ingest_create();
+    test_read();
+    test_receive();
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -32,10 +32,14 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
 #include "test_helper.h"
 #include "../src/ringbuffer.c"
 #include "../src/buffercache.c"
 #include <stdio.h>
+#include <pthread.h>
 #include <assert.h>
 #include <stdint.h>
 #include <string.h>
@@ -112,11 +116,562 @@ void test_buffercache_caching() {
 
 }
 
+/*----------------------------------------------------------------------------*/
+
+static size_t num_reclaimed = 0;
+
+static void count_free_buffers(void** buffers, size_t n, void* arg) {
+
+    num_reclaimed += n;
+    buffercache_free_buffers(buffers, n, arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_reclaimer() {
+
+    assert(0 == buffercache_create_with_reclaimer(4, 0));
+
+    Reclaimer* reclaimer = reclaimer_create(4, 3, count_free_buffers, 0);
+    Ringbuffer* cache = buffercache_create_with_reclaimer(4, reclaimer);
+
+    for(size_t i = 0; i < 12; ++i) {
+        Buffer* buffer = buffercache_get_buffer(0, 10);
+        assert(buffercache_release_buffer(cache, buffer));
+    }
+
+    /* Overwritten Buffer s are freed on reclaim only */
+    assert(0 == num_reclaimed);
+    assert(8 == reclaimer->reclaim(reclaimer));
+    assert(8 == num_reclaimed);
+
+    assert(0 == cache->free(cache));
+    assert(0 == reclaimer->free(reclaimer));
+    assert(12 == num_reclaimed);
+
+    fprintf(stdout, "Reclaimer ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_classes() {
+
+    assert(0 == buffercache_create_with_classes(0, 64, 4));
+    assert(0 == buffercache_create_with_classes(128, 64, 4));
+    assert(0 == buffercache_create_with_classes(64, 128, 0));
+    assert(0 == buffercache_create_with_classes(100, 120, 4));
+
+    /* 7 classes: 64, 128, ..., 4096 */
+    Ringbuffer* cache = buffercache_create_with_classes(50, 4096, 4);
+    assert(0 != cache);
+    assert(7 * 4 == cache->capacity(cache));
+
+    /* Served from the smallest class that fits */
+    Buffer* buffer = buffercache_get_buffer(cache, 1);
+    assert(64 == buffer->capacity_bytes);
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(buffer == buffercache_get_buffer(cache, 64));
+    assert(buffercache_release_buffer(cache, buffer));
+
+    buffer = buffercache_get_buffer(cache, 65);
+    assert(128 == buffer->capacity_bytes);
+    assert(buffercache_release_buffer(cache, buffer));
+
+    /* Too large for any class - neither cached nor kept */
+    buffer = buffercache_get_buffer(cache, 5000);
+    assert(5000 <= buffer->capacity_bytes);
+    assert(buffercache_release_buffer(cache, buffer));
+
+    /* Buffer s from elsewhere go into the largest class they fit */
+    buffer = buffercache_get_buffer(0, 1000);
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(buffer == buffercache_get_buffer(cache, 512));
+
+    buffer->capacity_bytes = 10;
+    assert(buffercache_release_buffer(cache, buffer));
+
+    /* Mixed sizes: Once warmed up, each request hits the cache */
+    const size_t sizes[] = {64, 200, 1500, 4096, 64000, 100, 3000, 700};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    Buffer* buffers[num_sizes];
+
+    for(size_t i = 0; i < num_sizes; ++i) {
+        buffers[i] = buffercache_get_buffer(cache, sizes[i]);
+        assert(sizes[i] <= buffers[i]->capacity_bytes);
+    }
+
+    for(size_t i = 0; i < num_sizes; ++i) {
+        assert(buffercache_release_buffer(cache, buffers[i]));
+    }
+
+#if defined(RINGBUFFER_STATS)
+    RingbufferStats before;
+    assert(cache->stats(cache, &before));
+#endif
+
+    for(size_t round = 0; round < 100; ++round) {
+
+        for(size_t i = 0; i < num_sizes; ++i) {
+
+            Buffer* buffer = buffercache_get_buffer(cache, sizes[i]);
+            assert(sizes[i] <= buffer->capacity_bytes);
+            assert(0 == buffer->bytes_used);
+
+            if(64000 != sizes[i]) {
+                assert(buffer == buffers[i]);
+            }
+
+            buffer->bytes_used = sizes[i];
+            assert(buffercache_release_buffer(cache, buffer));
+
+        }
+
+    }
+
+#if defined(RINGBUFFER_STATS)
+    RingbufferStats after;
+    assert(cache->stats(cache, &after));
+
+    /* The oversized Buffer never reaches a class */
+    assert(before.cache_misses == after.cache_misses);
+    assert(before.cache_hits + 100 * (num_sizes - 1) == after.cache_hits);
+#endif
+
+    /* As a Ringbuffer, the cache pops the smallest Buffer s first */
+    buffer = cache->pop(cache);
+    assert(64 == buffer->capacity_bytes);
+    buffer_free(buffer, 0);
+
+    assert(cache->resize(cache, 14));
+    assert(14 == cache->capacity(cache));
+
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Size classes ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_slabs() {
+
+    assert(0 == buffercache_create_with_slabs(0, 4));
+    assert(0 == buffercache_create_with_slabs(100, 0));
+
+    Ringbuffer* cache = buffercache_create_with_slabs(100, 4);
+    assert(0 != cache);
+    assert(! cache->resize(cache, 100));
+
+    /* More Buffer s than fit into one slab */
+    Buffer* buffers[10] = {0};
+
+    for(size_t i = 0; i < 10; ++i) {
+
+        buffers[i] = buffercache_get_buffer(cache, 1 + 10 * i);
+        assert(100 == buffers[i]->capacity_bytes);
+        assert(0 == buffers[i]->bytes_used);
+
+        /* Header and payload in one block */
+        assert((uint8_t*) buffers[i] + sizeof(Buffer) == buffers[i]->data);
+        assert(0 == (uintptr_t) buffers[i] % 64);
+
+        memset(buffers[i]->data, 0xff, buffers[i]->capacity_bytes);
+        buffers[i]->bytes_used = buffers[i]->capacity_bytes;
+
+    }
+
+    assert(10 <= cache->capacity(cache));
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(buffercache_release_buffer(cache, buffers[i]));
+    }
+
+#if defined(RINGBUFFER_STATS)
+    RingbufferStats before;
+    assert(cache->stats(cache, &before));
+#endif
+
+    /* All served from the released Buffer s */
+    for(size_t round = 0; round < 100; ++round) {
+
+        Buffer* buffer = buffercache_get_buffer(cache, 100);
+
+        bool found = false;
+
+        for(size_t i = 0; i < 10; ++i) {
+            found |= (buffer == buffers[i]);
+        }
+
+        assert(found);
+        assert(0 == buffer->bytes_used);
+        assert(buffercache_release_buffer(cache, buffer));
+
+    }
+
+#if defined(RINGBUFFER_STATS)
+    RingbufferStats after;
+    assert(cache->stats(cache, &after));
+    assert(before.cache_misses == after.cache_misses);
+    assert(before.cache_hits + 100 == after.cache_hits);
+#endif
+
+    /* Too large and foreign Buffer s are freed on release */
+    Buffer* buffer = buffercache_get_buffer(cache, 101);
+    assert(101 == buffer->capacity_bytes);
+    assert(buffercache_release_buffer(cache, buffer));
+
+    buffer = buffercache_get_buffer(0, 50);
+    assert(buffercache_release_buffer(cache, buffer));
+
+    assert(10 == cache->pop_n(cache, (void**) buffers, 10));
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(buffercache_release_buffer(cache, buffers[i]));
+    }
+
+    /* Frees the slabs, not the Buffer s */
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Slabs ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#define NUM_REMOTE_THREADS 4
+#define NUM_REMOTE_BUFFERS 1000
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    Ringbuffer* cache;
+    Buffer** buffers;
+    size_t num_buffers;
+
+} RemoteArg;
+
+/*----------------------------------------------------------------------------*/
+
+static void* release_remote(void* arg) {
+
+    RemoteArg* remote = arg;
+
+    for(size_t i = 0; i < remote->num_buffers; ++i) {
+        assert(buffercache_release_buffer_remote(
+                    remote->cache, remote->buffers[i]));
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_inbox() {
+
+    assert(0 == buffercache_create_with_inbox(0));
+
+    Ringbuffer* plain = buffercache_create(4);
+    Buffer* buffer = buffercache_get_buffer(plain, 10);
+    assert(! buffercache_release_buffer_remote(plain, buffer));
+    assert(! buffercache_release_buffer_remote(0, buffer));
+
+    Ringbuffer* cache = buffercache_create_with_inbox(plain);
+    assert(4 == cache->capacity(cache));
+    assert(! buffercache_release_buffer_remote(cache, 0));
+
+    /* Collected on the next get */
+    assert(buffercache_release_buffer_remote(cache, buffer));
+    assert(buffer == buffercache_get_buffer(cache, 10));
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(buffer == buffercache_get_buffer(cache, 10));
+    assert(buffercache_release_buffer(cache, buffer));
+
+    /* Other threads release while the owner keeps getting */
+    static Buffer* buffers[NUM_REMOTE_BUFFERS];
+
+    for(size_t i = 0; i < NUM_REMOTE_BUFFERS; ++i) {
+        buffers[i] = buffercache_get_buffer(cache, 10);
+    }
+
+    pthread_t threads[NUM_REMOTE_THREADS];
+    RemoteArg args[NUM_REMOTE_THREADS];
+
+    for(size_t i = 0; i < NUM_REMOTE_THREADS; ++i) {
+
+        size_t n = NUM_REMOTE_BUFFERS / NUM_REMOTE_THREADS;
+
+        args[i] = (RemoteArg) {
+            .cache = cache,
+            .buffers = buffers + i * n,
+            .num_buffers = n,
+        };
+
+        assert(0 == pthread_create(threads + i, 0, release_remote, args + i));
+
+    }
+
+    for(size_t i = 0; i < 10 * NUM_REMOTE_BUFFERS; ++i) {
+        Buffer* local = buffercache_get_buffer(cache, 10);
+        local->bytes_used = 1;
+        assert(buffercache_release_buffer(cache, local));
+    }
+
+    for(size_t i = 0; i < NUM_REMOTE_THREADS; ++i) {
+        assert(0 == pthread_join(threads[i], 0));
+    }
+
+    /* Collects the remainder, all but 4 overwritten ones are freed */
+    buffer = buffercache_get_buffer(cache, 10);
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(4 == cache->pop_n(cache, (void**) buffers, NUM_REMOTE_BUFFERS));
+    buffercache_free_buffers((void**) buffers, 4, 0);
+
+    /* Frees remotely released Buffer s and the wrapped cache */
+    buffer = buffercache_get_buffer(0, 10);
+    assert(buffercache_release_buffer_remote(cache, buffer));
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Inbox ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#define NUM_RECLAIMED_BUFFERS 64
+
+static void* reclaim_remote(void* arg) {
+
+    Reclaimer* reclaimer = arg;
+
+    size_t num_reclaimed = 0;
+
+    while(NUM_RECLAIMED_BUFFERS > num_reclaimed) {
+        num_reclaimed += reclaimer->reclaim(reclaimer);
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_remote_reclaim() {
+
+    /* Slab Buffer s freed by a background reclaimer */
+    Ringbuffer* cache =
+        buffercache_create_with_inbox(buffercache_create_with_slabs(10, 8));
+    Reclaimer* reclaimer = reclaimer_create(
+            8, NUM_RECLAIMED_BUFFERS / 8, buffercache_free_buffers, 0);
+
+    static Buffer* buffers[NUM_RECLAIMED_BUFFERS];
+
+    for(size_t i = 0; i < NUM_RECLAIMED_BUFFERS; ++i) {
+        buffers[i] = buffercache_get_buffer(cache, 10);
+    }
+
+    pthread_t thread;
+    assert(0 == pthread_create(&thread, 0, reclaim_remote, reclaimer));
+
+    for(size_t i = 0; i < NUM_RECLAIMED_BUFFERS; ++i) {
+
+        assert(reclaimer->collect(reclaimer, buffers[i]));
+
+        /* The owner keeps using its cache meanwhile */
+        Buffer* local = buffercache_get_buffer(cache, 10);
+        assert(buffercache_release_buffer(cache, local));
+
+    }
+
+    assert(reclaimer->flush(reclaimer));
+    assert(0 == pthread_join(thread, 0));
+
+    /* All of them came back via the inbox, none was freed.
+     * One more Buffer has been carved for the owner meanwhile */
+    size_t num_found = 0;
+
+    for(size_t i = 0; i < NUM_RECLAIMED_BUFFERS + 1; ++i) {
+
+        Buffer* buffer = buffercache_get_buffer(cache, 10);
+
+        for(size_t j = 0; j < NUM_RECLAIMED_BUFFERS; ++j) {
+            num_found += (buffer == buffers[j]);
+        }
+
+    }
+
+    assert(NUM_RECLAIMED_BUFFERS == num_found);
+
+    assert(0 == reclaimer->free(reclaimer));
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "Remote reclaim ok\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+#define NUM_CONSUMERS 4
+#define NUM_FAN_OUT 1000
+
+/*----------------------------------------------------------------------------*/
+
+static void* release_fanned_out(void* arg) {
+
+    RemoteArg* remote = arg;
+
+    for(size_t i = 0; i < remote->num_buffers; ++i) {
+        assert(42 == remote->buffers[i]->data[0]);
+        assert(buffercache_release_buffer_remote(
+                    remote->cache, remote->buffers[i]));
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_buffercache_refs() {
+
+    assert(0 == buffercache_retain_buffer(0));
+
+    Ringbuffer* cache = buffercache_create(4);
+
+    /* Only the last release puts the Buffer back */
+    Buffer* buffer = buffercache_get_buffer(cache, 10);
+    assert(buffer == buffercache_retain_buffer(buffer));
+    assert(buffer == buffercache_retain_buffer(buffer));
+
+    buffer->bytes_used = 5;
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(5 == buffer->bytes_used);
+    assert(0 == cache->pop(cache));
+
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(0 == buffer->bytes_used);
+    assert(buffer == buffercache_get_buffer(cache, 10));
+    assert(1 == buffer->refs);
+
+    /* Freeing honours references as well */
+    buffercache_retain_buffer(buffer);
+    buffercache_free_buffers((void**) &buffer, 1, 0);
+    assert(1 == buffer->refs);
+    buffercache_free_buffers((void**) &buffer, 1, 0);
+
+    /* Buffer s not from a cache count as a single reference */
+    buffer = calloc(1, sizeof(Buffer));
+    buffercache_retain_buffer(buffer);
+    assert(2 == buffer->refs);
+    buffercache_free_buffers((void**) &buffer, 1, 0);
+    buffercache_free_buffers((void**) &buffer, 1, 0);
+
+    assert(0 == cache->free(cache));
+
+    /* Fan out to several consumer threads without copying */
+    cache = buffercache_create_with_inbox(buffercache_create(NUM_FAN_OUT));
+
+    static Buffer* buffers[NUM_FAN_OUT];
+
+    for(size_t i = 0; i < NUM_FAN_OUT; ++i) {
+
+        buffers[i] = buffercache_get_buffer(cache, 10);
+        buffers[i]->data[0] = 42;
+
+        for(size_t c = 1; c < NUM_CONSUMERS; ++c) {
+            buffercache_retain_buffer(buffers[i]);
+        }
+
+    }
+
+    pthread_t threads[NUM_CONSUMERS];
+    RemoteArg args[NUM_CONSUMERS];
+
+    for(size_t i = 0; i < NUM_CONSUMERS; ++i) {
+
+        args[i] = (RemoteArg) {
+            .cache = cache,
+            .buffers = buffers,
+            .num_buffers = NUM_FAN_OUT,
+        };
+
+        assert(0 == pthread_create(
+                    threads + i, 0, release_fanned_out, args + i));
+
+    }
+
+    for(size_t i = 0; i < NUM_CONSUMERS; ++i) {
+        assert(0 == pthread_join(threads[i], 0));
+    }
+
+    /* Each Buffer came back exactly once */
+    buffer = buffercache_get_buffer(cache, 10);
+    assert(buffercache_release_buffer(cache, buffer));
+    assert(NUM_FAN_OUT == cache->pop_n(cache, (void**) buffers, NUM_FAN_OUT));
+    assert(0 == cache->pop(cache));
+
+    buffercache_free_buffers((void**) buffers, NUM_FAN_OUT, 0);
+    assert(0 == cache->free(cache));
+
+    /* The last reference goes back to the owner, whatever cache is given */
+    Ringbuffer* slabs = buffercache_create_with_slabs(10, 4);
+    Ringbuffer* other = buffercache_create(4);
+
+    buffer = buffercache_get_buffer(slabs, 10);
+    assert(slabs == buffer->owner);
+    buffercache_retain_buffer(buffer);
+
+    assert(buffercache_release_buffer(slabs, buffer));
+    assert(buffercache_release_buffer(other, buffer));
+    assert(0 == other->pop(other));
+    assert(buffer == slabs->pop(slabs));
+
+    /* Remotely as well, via the inbox the Buffer was got from */
+    cache = buffercache_create_with_inbox(slabs);
+    Ringbuffer* inbox = buffercache_create_with_inbox(other);
+
+    buffer = buffercache_get_buffer(cache, 10);
+    assert(cache == buffer->owner);
+    assert(buffercache_release_buffer_remote(inbox, buffer));
+    assert(0 == inbox->pop(inbox));
+    assert(buffer == buffercache_get_buffer(cache, 10));
+
+    assert(buffercache_release_buffer(other, buffer));
+    assert(buffer == cache->pop(cache));
+
+    /* Freeing an owned Buffer hands it back rather than calling free() */
+    buffercache_free_buffers((void**) &buffer, 1, 0);
+    assert(buffer == cache->pop(cache));
+
+    buffercache_release_or_free_buffer(0, buffer);
+    assert(buffer == cache->pop(cache));
+
+    /* Unowned ones are freed if they cannot be cached */
+    buffer = buffercache_get_buffer(0, 10);
+    buffercache_release_or_free_buffer(0, buffer);
+
+    assert(0 == inbox->free(inbox));
+    assert(0 == cache->free(cache));
+
+    fprintf(stdout, "References ok\n");
+
+}
+
 /*----------------------------------------------------------------------------*/
 int main(int argc, char** argv) {
 
     /* Caching tests */
     test_buffercache_caching();
+    test_buffercache_reclaimer();
+    test_buffercache_classes();
+    test_buffercache_slabs();
+    test_buffercache_inbox();
+    test_buffercache_remote_reclaim();
+    test_buffercache_refs();
 
 }
 
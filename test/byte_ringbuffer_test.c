@@ -0,0 +1,320 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+
+#include "../src/byte_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*----------------------------------------------------------------------------*/
+
+void test_byte_ringbuffer_create() {
+
+    ByteRingbuffer* buffer = 0;
+
+    assert(0 == byte_ringbuffer_create(0));
+
+    buffer = byte_ringbuffer_create(1);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(reserve_func == buffer->reserve);
+    assert(commit_func == buffer->commit);
+    assert(peek_func == buffer->peek);
+    assert(release_func == buffer->release);
+    assert(free_func == buffer->free);
+    assert(CACHE_LINE_SIZE == buffer->capacity(buffer));
+    buffer = buffer->free(buffer);
+
+    buffer = byte_ringbuffer_create(1000);
+    assert(1024 == buffer->capacity(buffer));
+    assert(0 == buffer->free(buffer));
+
+    assert(0 == free_func(0));
+
+    fprintf(stdout, "byte_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_reserve_commit() {
+
+    size_t length = 0;
+
+    ByteRingbuffer* buffer = byte_ringbuffer_create(128);
+
+    assert(0 == buffer->peek(buffer, &length));
+    assert(! buffer->release(buffer));
+    assert(! buffer->commit(buffer, 0));
+
+    /* Does not fit at all */
+    assert(0 == buffer->reserve(buffer, 128));
+
+    uint8_t* record = buffer->reserve(buffer, 10);
+    assert(record);
+    assert(! buffer->commit(buffer, 11));
+
+    memcpy(record, "abcdef", 6);
+    assert(buffer->commit(buffer, 6));
+    assert(! buffer->commit(buffer, 6));
+
+    /* Reserving again discards the first reservation */
+    assert(buffer->reserve(buffer, 3));
+    record = buffer->reserve(buffer, 3);
+    memcpy(record, "xyz", 3);
+    assert(buffer->commit(buffer, 3));
+
+    record = buffer->peek(buffer, &length);
+    assert(6 == length);
+    assert(0 == memcmp(record, "abcdef", 6));
+    assert(record == buffer->peek(buffer, 0));
+    assert(buffer->release(buffer));
+
+    record = buffer->peek(buffer, &length);
+    assert(3 == length);
+    assert(0 == memcmp(record, "xyz", 3));
+    assert(buffer->release(buffer));
+
+    assert(0 == buffer->peek(buffer, &length));
+    assert(! buffer->release(buffer));
+
+    /* Zero-length records */
+    assert(buffer->reserve(buffer, 0));
+    assert(buffer->commit(buffer, 0));
+    assert(buffer->peek(buffer, &length));
+    assert(0 == length);
+    assert(buffer->release(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "reserve()/commit()/peek()/release() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_full_and_wrap_around() {
+
+    size_t length = 0;
+
+    ByteRingbuffer* buffer = byte_ringbuffer_create(128);
+
+    /* 5 records a 24 bytes */
+    for(uint8_t i = 0; i < 5; ++i) {
+        uint8_t* record = buffer->reserve(buffer, 13);
+        assert(record);
+        memset(record, i, 13);
+        assert(buffer->commit(buffer, 13));
+    }
+
+    assert(0 == buffer->reserve(buffer, 13));
+
+    for(uint8_t round = 0; round < 100; ++round) {
+
+        assert(buffer->peek(buffer, &length));
+        assert(buffer->release(buffer));
+
+        /* Record sizes vary, some need to skip the end of the memory */
+        size_t record_length = 1 + round % 16;
+
+        uint8_t* record = buffer->reserve(buffer, record_length);
+
+        if(0 == record) {
+            assert(buffer->release(buffer));
+            record = buffer->reserve(buffer, record_length);
+        }
+
+        assert(record);
+        memset(record, round, record_length);
+        assert(buffer->commit(buffer, record_length));
+
+    }
+
+    uint8_t* record = 0;
+    uint8_t last_round = 0;
+
+    while(0 != (record = buffer->peek(buffer, &length))) {
+
+        for(size_t i = 1; i < length; ++i) {
+            assert(record[0] == record[i]);
+        }
+
+        last_round = record[0];
+        assert(buffer->release(buffer));
+
+    }
+
+    assert(99 == last_round);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "full and wrap around OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_max_record_length() {
+
+    size_t length = 0;
+
+    ByteRingbuffer* buffer = byte_ringbuffer_create(64);
+    const size_t max_length = buffer->capacity(buffer) / 2 - sizeof(size_t);
+
+    assert(0 == buffer->reserve(buffer, max_length + 1));
+
+    /* Used to fail forever once the empty ringbuffer was written mid-way */
+    assert(buffer->reserve(buffer, 24));
+    assert(buffer->commit(buffer, 24));
+    assert(buffer->peek(buffer, &length));
+    assert(buffer->release(buffer));
+
+    assert(0 == buffer->reserve(buffer, 40));
+
+    /* A record of maximum length fits an empty ringbuffer at any offset */
+    for(size_t round = 0; round < 32; ++round) {
+
+        size_t skip = round % 4 * sizeof(size_t);
+
+        assert(buffer->reserve(buffer, skip));
+        assert(buffer->commit(buffer, skip));
+        assert(buffer->peek(buffer, &length));
+        assert(buffer->release(buffer));
+
+        uint8_t* record = buffer->reserve(buffer, max_length);
+        assert(record);
+        memset(record, (uint8_t) round, max_length);
+        assert(buffer->commit(buffer, max_length));
+
+        record = buffer->peek(buffer, &length);
+        assert(max_length == length);
+        assert((uint8_t) round == record[max_length - 1]);
+        assert(buffer->release(buffer));
+
+    }
+
+    assert(0 == buffer->peek(buffer, &length));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "maximum record length OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const uint32_t NUM_RECORDS = 200 * 1000;
+
+/*----------------------------------------------------------------------------*/
+
+static void* producer(void* arg) {
+
+    ByteRingbuffer* buffer = arg;
+
+    for(uint32_t i = 0; i < NUM_RECORDS; ++i) {
+
+        size_t length = sizeof(uint32_t) * (1 + i % 31);
+
+        uint32_t* record = 0;
+
+        while(0 == (record = (uint32_t*) buffer->reserve(buffer, length))) {
+            sched_yield();
+        }
+
+        for(size_t j = 0; j < length / sizeof(uint32_t); ++j) {
+            record[j] = i;
+        }
+
+        assert(buffer->commit(buffer, length));
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_transfer() {
+
+    ByteRingbuffer* buffer = byte_ringbuffer_create(4096);
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(&producer_thread, 0, producer, buffer));
+
+    for(uint32_t i = 0; i < NUM_RECORDS; ++i) {
+
+        size_t length = 0;
+        uint32_t* record = 0;
+
+        while(0 == (record = (uint32_t*) buffer->peek(buffer, &length))) {
+            sched_yield();
+        }
+
+        assert(sizeof(uint32_t) * (1 + i % 31) == length);
+
+        for(size_t j = 0; j < length / sizeof(uint32_t); ++j) {
+            assert(i == record[j]);
+        }
+
+        assert(buffer->release(buffer));
+
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+    assert(0 == buffer->peek(buffer, 0));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent transfer OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    test_byte_ringbuffer_create();
+    test_reserve_commit();
+    test_full_and_wrap_around();
+    test_max_record_length();
+    test_concurrent_transfer();
+
+}
+
+/*----------------------------------------------------------------------------*/
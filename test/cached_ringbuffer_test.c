@@ -33,6 +33,7 @@
  */
 /*----------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE
 
 #include "test_helper.h"
 #include "../src/ringbuffer.c"
@@ -223,6 +224,12 @@ int main(int argc, char** argv) {
     test_capacity();
     test_add();
     test_pop();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_resize();
     cache->free(cache);
     cache = 0;
 
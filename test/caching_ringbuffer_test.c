@@ -164,6 +164,37 @@ void test_caching_free() {
 
 }
 
+/*----------------------------------------------------------------------------*/
+
+void test_caching_stats() {
+
+#if defined(RINGBUFFER_STATS)
+
+    int a[3];
+    RingbufferStats stats;
+
+    Ringbuffer* buffer = caching_ringbuffer_create(1, 0, 0);
+
+    assert(0 == caching_ringbuffer_get_cached(buffer));
+    assert(buffer->add(buffer, a));
+    assert(buffer->add(buffer, a + 1));
+    assert(a == caching_ringbuffer_get_cached(buffer));
+    assert(0 == caching_ringbuffer_get_cached(buffer));
+
+    assert(buffer->stats(buffer, &stats));
+    assert(2 == stats.adds);
+    assert(1 == stats.overwrites);
+    assert(1 == stats.cache_hits);
+    assert(2 == stats.cache_misses);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "caching stats OK\n");
+
+#endif
+
+}
+
 /*----------------------------------------------------------------------------*/
 int main(int argc, char** argv) {
 
@@ -180,6 +211,12 @@ int main(int argc, char** argv) {
     test_capacity();
     test_add();
     test_pop();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_resize();
     cache->free(cache);
     cache = 0;
 
@@ -188,6 +225,7 @@ int main(int argc, char** argv) {
     test_caching_ringbuffer_get_cached();
     test_caching_ringbuffer_release();
     test_caching_free();
+    test_caching_stats();
 
 }
 
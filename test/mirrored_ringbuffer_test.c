@@ -0,0 +1,235 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+
+#include "../src/mirrored_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*----------------------------------------------------------------------------*/
+
+void test_mirrored_ringbuffer_create() {
+
+    MirroredRingbuffer* buffer = 0;
+
+    assert(0 == mirrored_ringbuffer_create(0));
+
+    buffer = mirrored_ringbuffer_create(1);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(write_span_func == buffer->write_span);
+    assert(produce_func == buffer->produce);
+    assert(read_span_func == buffer->read_span);
+    assert(consume_func == buffer->consume);
+    assert(free_func == buffer->free);
+    assert((size_t) sysconf(_SC_PAGESIZE) == buffer->capacity(buffer));
+    buffer = buffer->free(buffer);
+
+    buffer = mirrored_ringbuffer_create(100 * 1000);
+    assert(128 * 1024 == buffer->capacity(buffer));
+    assert(0 == buffer->free(buffer));
+
+    assert(0 == free_func(0));
+
+    fprintf(stdout, "mirrored_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_mirroring() {
+
+    size_t length = 0;
+
+    MirroredRingbuffer* buffer = mirrored_ringbuffer_create(1);
+    const size_t capacity = buffer->capacity(buffer);
+
+    uint8_t* memory = buffer->write_span(buffer, &length);
+    assert(capacity == length);
+
+    memory[0] = 42;
+    assert(42 == memory[capacity]);
+    memory[2 * capacity - 1] = 43;
+    assert(43 == memory[capacity - 1]);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "mirroring OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_spans() {
+
+    size_t length = 0;
+
+    MirroredRingbuffer* buffer = mirrored_ringbuffer_create(1);
+    const size_t capacity = buffer->capacity(buffer);
+
+    uint8_t* read = buffer->read_span(buffer, &length);
+    assert(read);
+    assert(0 == length);
+    assert(! buffer->consume(buffer, 1));
+    assert(! buffer->produce(buffer, capacity + 1));
+
+    /* Move the positions close to the end of the memory */
+    assert(buffer->produce(buffer, capacity - 10));
+    assert(buffer->consume(buffer, capacity - 10));
+
+    uint8_t* write = buffer->write_span(buffer, &length);
+    assert(capacity == length);
+
+    /* Write across the end of the memory in one go */
+    for(size_t i = 0; i < 100; ++i) {
+        write[i] = i;
+    }
+
+    assert(buffer->produce(buffer, 100));
+
+    write = buffer->write_span(buffer, &length);
+    assert(capacity - 100 == length);
+
+    read = buffer->read_span(buffer, &length);
+    assert(100 == length);
+
+    for(size_t i = 0; i < 100; ++i) {
+        assert(i == read[i]);
+    }
+
+    assert(! buffer->consume(buffer, 101));
+    assert(buffer->consume(buffer, 100));
+
+    read = buffer->read_span(buffer, &length);
+    assert(0 == length);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "write_span()/produce()/read_span()/consume() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const size_t NUM_BYTES = 10 * 1000 * 1000;
+
+/*----------------------------------------------------------------------------*/
+
+static void* producer(void* arg) {
+
+    MirroredRingbuffer* buffer = arg;
+
+    size_t written = 0;
+
+    while(written < NUM_BYTES) {
+
+        size_t length = 0;
+        uint8_t* span = buffer->write_span(buffer, &length);
+
+        if(0 == length) {
+            sched_yield();
+            continue;
+        }
+
+        if(length > NUM_BYTES - written) {
+            length = NUM_BYTES - written;
+        }
+
+        for(size_t i = 0; i < length; ++i) {
+            span[i] = (uint8_t) (written + i);
+        }
+
+        assert(buffer->produce(buffer, length));
+        written += length;
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_transfer() {
+
+    MirroredRingbuffer* buffer = mirrored_ringbuffer_create(1);
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(&producer_thread, 0, producer, buffer));
+
+    size_t read = 0;
+
+    while(read < NUM_BYTES) {
+
+        size_t length = 0;
+        uint8_t* span = buffer->read_span(buffer, &length);
+
+        if(0 == length) {
+            sched_yield();
+            continue;
+        }
+
+        for(size_t i = 0; i < length; ++i) {
+            assert((uint8_t) (read + i) == span[i]);
+        }
+
+        assert(buffer->consume(buffer, length));
+        read += length;
+
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent transfer OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    test_mirrored_ringbuffer_create();
+    test_mirroring();
+    test_spans();
+    test_concurrent_transfer();
+
+}
+
+/*----------------------------------------------------------------------------*/
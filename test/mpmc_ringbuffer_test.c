@@ -0,0 +1,586 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "test_helper.h"
+#include "../src/mpmc_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* create_waitable(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    return mpmc_ringbuffer_create_with_policy(capacity,
+            RINGBUFFER_REJECT | RINGBUFFER_WAITABLE,
+            free_item, free_item_additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_mpmc_ringbuffer_create() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == mpmc_ringbuffer_create(0, 0, 0));
+
+    buffer = mpmc_ringbuffer_create(1, 0, 0);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(add_func == buffer->add);
+    assert(pop_func == buffer->pop);
+    assert(free_func == buffer->free);
+    assert(1 == buffer->capacity(buffer));
+    buffer = buffer->free(buffer);
+
+    buffer = mpmc_ringbuffer_create(13, 0, 0);
+    assert(16 == buffer->capacity(buffer));
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "mpmc_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_mpmc_add_pop() {
+
+    int a[20];
+
+    Ringbuffer* buffer = mpmc_ringbuffer_create(16, 0, 0);
+
+    assert(! buffer->add(buffer, 0));
+    assert(0 == buffer->pop(buffer));
+
+    for(size_t round = 0; round < 5; ++round) {
+
+        for(size_t i = 0; i < 16; ++i) {
+            assert(buffer->add(buffer, a + i));
+        }
+
+        /* Full - nothing is overwritten */
+        assert(! buffer->add(buffer, a + 16));
+
+        for(size_t i = 0; i < 16; ++i) {
+            assert(a + i == buffer->pop(buffer));
+        }
+
+        assert(0 == buffer->pop(buffer));
+
+    }
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "mpmc add()/pop() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_mpmc_add_n_pop_n() {
+
+    int a[40];
+    void* items[40];
+    void* out[40];
+
+    for(size_t i = 0; i < 40; ++i) {
+        items[i] = a + i;
+    }
+
+    Ringbuffer* buffer = mpmc_ringbuffer_create(16, 0, 0);
+
+    for(size_t round = 0; round < 5; ++round) {
+
+        /* Only as many elements as fit are added */
+        assert(16 == buffer->add_n(buffer, items, 40));
+        assert(0 == buffer->add_n(buffer, items, 40));
+        assert(3 == buffer->pop_n(buffer, out, 3));
+        assert(3 == buffer->add_n(buffer, items + 30, 10));
+        assert(16 == buffer->pop_n(buffer, out, 40));
+
+        for(size_t i = 0; i < 13; ++i) {
+            assert(items[3 + i] == out[i]);
+        }
+
+        for(size_t i = 0; i < 3; ++i) {
+            assert(items[30 + i] == out[13 + i]);
+        }
+
+    }
+
+    /* Stops at the first 0 */
+    items[2] = 0;
+    assert(2 == buffer->add_n(buffer, items, 10));
+    assert(2 == buffer->pop_n(buffer, out, 10));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "mpmc add_n()/pop_n() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void count_free(void* item, void* count) {
+
+    size_t* c = (size_t*) count;
+    *c = *c + 1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_free() {
+
+    int a = 1;
+    size_t count = 0;
+
+    assert(0 == free_func(0));
+
+    Ringbuffer* buffer = mpmc_ringbuffer_create(32, count_free, &count);
+
+    for(size_t i = 0; i < 40; ++i) {
+        buffer->add(buffer, &a);
+    }
+
+    assert(&a == buffer->pop(buffer));
+    assert(0 == buffer->free(buffer));
+    assert(31 == count);
+
+    fprintf(stdout, "free() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const uintptr_t ITEMS_PER_PRODUCER = 200 * 1000;
+
+typedef struct {
+
+    Ringbuffer* buffer;
+    atomic_size_t items_left_to_pop;
+    atomic_uintptr_t sum;
+
+} Transfer;
+
+/*----------------------------------------------------------------------------*/
+
+static void* producer(void* arg) {
+
+    Transfer* transfer = arg;
+    Ringbuffer* buffer = transfer->buffer;
+
+    for(uintptr_t i = 1; i <= ITEMS_PER_PRODUCER; ++i) {
+
+        while(! buffer->add(buffer, (void*) i)) {
+            sched_yield();
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* consumer(void* arg) {
+
+    Transfer* transfer = arg;
+    Ringbuffer* buffer = transfer->buffer;
+
+    uintptr_t sum = 0;
+
+    while(0 < atomic_load(&transfer->items_left_to_pop)) {
+
+        void* item = buffer->pop(buffer);
+
+        if(0 == item) {
+            sched_yield();
+            continue;
+        }
+
+        sum += (uintptr_t) item;
+        atomic_fetch_sub(&transfer->items_left_to_pop, 1);
+
+    }
+
+    atomic_fetch_add(&transfer->sum, sum);
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static double seconds_since(struct timespec* start) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + 1e-9 * (now.tv_nsec - start->tv_nsec);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Moves ITEMS_PER_PRODUCER items from each producer to the consumers,
+ * checks that every item arrived exactly once and reports the throughput.
+ */
+void test_concurrent_scaling() {
+
+    const size_t MAX_THREADS = 8;
+
+    fprintf(stdout, "producers,consumers,items,seconds,items_per_second\n");
+
+    for(size_t num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+
+        Transfer transfer = {
+            .buffer = mpmc_ringbuffer_create(1024, 0, 0),
+        };
+
+        const size_t num_items = num_threads * ITEMS_PER_PRODUCER;
+
+        atomic_init(&transfer.items_left_to_pop, num_items);
+        atomic_init(&transfer.sum, 0);
+
+        pthread_t producers[num_threads];
+        pthread_t consumers[num_threads];
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for(size_t i = 0; i < num_threads; ++i) {
+            assert(0 == pthread_create(consumers + i, 0, consumer, &transfer));
+            assert(0 == pthread_create(producers + i, 0, producer, &transfer));
+        }
+
+        for(size_t i = 0; i < num_threads; ++i) {
+            assert(0 == pthread_join(producers[i], 0));
+            assert(0 == pthread_join(consumers[i], 0));
+        }
+
+        const double seconds = seconds_since(&start);
+
+        const uintptr_t expected_sum =
+            num_threads * ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER + 1) / 2;
+
+        assert(expected_sum == atomic_load(&transfer.sum));
+        assert(0 == transfer.buffer->pop(transfer.buffer));
+
+        transfer.buffer = transfer.buffer->free(transfer.buffer);
+
+        fprintf(stdout, "%zu,%zu,%zu,%f,%.0f\n",
+                num_threads, num_threads, num_items, seconds,
+                num_items / seconds);
+
+    }
+
+    fprintf(stdout, "concurrent scaling OK\n");
+
+}
+
+static void* blocking_producer(void* arg) {
+
+    Transfer* transfer = arg;
+    Ringbuffer* buffer = transfer->buffer;
+
+    for(uintptr_t i = 1; i <= ITEMS_PER_PRODUCER; ++i) {
+        assert(buffer->add_wait(buffer, (void*) i, -1));
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* blocking_consumer(void* arg) {
+
+    Transfer* transfer = arg;
+    Ringbuffer* buffer = transfer->buffer;
+
+    uintptr_t sum = 0;
+
+    while(0 < atomic_load(&transfer->items_left_to_pop)) {
+
+        /* Other consumers might take the last items - thus no endless wait */
+        void* item = buffer->pop_wait(buffer, 10 * 1000);
+
+        if(0 == item) {
+            continue;
+        }
+
+        sum += (uintptr_t) item;
+        atomic_fetch_sub(&transfer->items_left_to_pop, 1);
+
+    }
+
+    atomic_fetch_add(&transfer->sum, sum);
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_blocking_transfer() {
+
+    const size_t NUM_THREADS = 4;
+
+    Transfer transfer = {
+        .buffer = create_waitable(8, 0, 0),
+    };
+
+    atomic_init(&transfer.items_left_to_pop, NUM_THREADS * ITEMS_PER_PRODUCER);
+    atomic_init(&transfer.sum, 0);
+
+    pthread_t producers[NUM_THREADS];
+    pthread_t consumers[NUM_THREADS];
+
+    for(size_t i = 0; i < NUM_THREADS; ++i) {
+        assert(0 == pthread_create(
+                    consumers + i, 0, blocking_consumer, &transfer));
+        assert(0 == pthread_create(
+                    producers + i, 0, blocking_producer, &transfer));
+    }
+
+    for(size_t i = 0; i < NUM_THREADS; ++i) {
+        assert(0 == pthread_join(producers[i], 0));
+        assert(0 == pthread_join(consumers[i], 0));
+    }
+
+    const uintptr_t expected_sum =
+        NUM_THREADS * ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER + 1) / 2;
+
+    assert(expected_sum == atomic_load(&transfer.sum));
+    assert(0 == transfer.buffer->pop(transfer.buffer));
+
+    transfer.buffer = transfer.buffer->free(transfer.buffer);
+
+    fprintf(stdout, "concurrent blocking transfer OK\n");
+
+}
+
+void test_mpmc_ringbuffer_create_with_policy() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == mpmc_ringbuffer_create_with_policy(
+                0, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == mpmc_ringbuffer_create_with_policy(
+                1, RINGBUFFER_OVERWRITE, 0, 0));
+    assert(0 == mpmc_ringbuffer_create_with_policy(
+                1, RINGBUFFER_OVERWRITE | RINGBUFFER_WAITABLE, 0, 0));
+
+    buffer = mpmc_ringbuffer_create_with_policy(1, RINGBUFFER_REJECT, 0, 0);
+    assert(add_func == buffer->add);
+    assert(add_n_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    buffer = mpmc_ringbuffer_create_with_policy(1, RINGBUFFER_BLOCK, 0, 0);
+    assert(add_block_func == buffer->add);
+    assert(add_n_block_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    test_reject_policy(mpmc_ringbuffer_create_with_policy);
+
+    fprintf(stdout, "mpmc_ringbuffer_create_with_policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Only waitable ringbuffers may check for waiting threads on add and pop.
+ * Fakes a waiting thread and checks whether it would be woken up.
+ */
+void test_notify_only_if_waitable() {
+
+    int a = 1;
+
+    Ringbuffer* buffer = mpmc_ringbuffer_create(2, 0, 0);
+    InternalRingbuffer* internal = (InternalRingbuffer*) buffer;
+
+    assert(! internal->waitable);
+    assert(-1 == buffer->event_fd(buffer, RINGBUFFER_NOT_EMPTY));
+    assert(-1 == buffer->event_fd(buffer, RINGBUFFER_NOT_FULL));
+
+    atomic_store(&internal->not_empty.num_waiters, 1);
+    atomic_store(&internal->not_full.num_waiters, 1);
+
+    assert(buffer->add(buffer, &a));
+    assert(&a == buffer->pop(buffer));
+    assert(1 == buffer->add_n(buffer, (void*[]){&a}, 1));
+    assert(1 == buffer->pop_n(buffer, (void*[1]){0}, 1));
+    assert(buffer->resize(buffer, 4));
+
+    assert(0 == atomic_load(&internal->not_empty.sequence));
+    assert(0 == atomic_load(&internal->not_full.sequence));
+
+    atomic_store(&internal->not_empty.num_waiters, 0);
+    atomic_store(&internal->not_full.num_waiters, 0);
+
+    buffer = buffer->free(buffer);
+
+    buffer = create_waitable(2, 0, 0);
+    internal = (InternalRingbuffer*) buffer;
+
+    assert(internal->waitable);
+
+    atomic_store(&internal->not_empty.num_waiters, 1);
+    atomic_store(&internal->not_full.num_waiters, 1);
+
+    assert(buffer->add(buffer, &a));
+    assert(1 == atomic_load(&internal->not_empty.sequence));
+    assert(&a == buffer->pop(buffer));
+    assert(1 == atomic_load(&internal->not_full.sequence));
+
+    atomic_store(&internal->not_empty.num_waiters, 0);
+    atomic_store(&internal->not_full.num_waiters, 0);
+
+    buffer = buffer->free(buffer);
+
+    buffer = mpmc_ringbuffer_create_with_policy(2, RINGBUFFER_BLOCK, 0, 0);
+    assert(((InternalRingbuffer*) buffer)->waitable);
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "notify only if waitable OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* batch_consumer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+
+    void* out[3];
+    uintptr_t expected = 1;
+
+    while(expected <= 1000) {
+
+        size_t num_popped = buffer->pop_n(buffer, out, 3);
+
+        if(0 == num_popped) {
+            sched_yield();
+            continue;
+        }
+
+        for(size_t i = 0; i < num_popped; ++i) {
+            assert(expected++ == (uintptr_t) out[i]);
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_block_policy() {
+
+    void* items[10];
+
+    Ringbuffer* buffer =
+        mpmc_ringbuffer_create_with_policy(4, RINGBUFFER_BLOCK, 0, 0);
+
+    pthread_t consumer_thread;
+    assert(0 == pthread_create(&consumer_thread, 0, batch_consumer, buffer));
+
+    for(uintptr_t i = 1; i <= 500; ++i) {
+        assert(buffer->add(buffer, (void*) i));
+    }
+
+    for(uintptr_t i = 501; i <= 1000; i += 10) {
+
+        for(uintptr_t j = 0; j < 10; ++j) {
+            items[j] = (void*) (i + j);
+        }
+
+        assert(10 == buffer->add_n(buffer, items, 10));
+
+    }
+
+    assert(0 == pthread_join(consumer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "RINGBUFFER_BLOCK OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    create = mpmc_ringbuffer_create;
+
+    test_ringbuffer_create();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_resize();
+    test_mpmc_ringbuffer_create();
+    test_mpmc_add_pop();
+    test_mpmc_add_n_pop_n();
+    test_free();
+    test_mpmc_ringbuffer_create_with_policy();
+    test_notify_only_if_waitable();
+    test_block_policy();
+    test_concurrent_scaling();
+    test_concurrent_blocking_transfer();
+
+    create = create_waitable;
+
+    test_pop_wait_add_wait();
+    test_event_fd();
+
+}
+
+/*----------------------------------------------------------------------------*/
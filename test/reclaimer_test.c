@@ -0,0 +1,253 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#include "../include/ringbuffer.h"
+#include "../src/reclaimer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    atomic_size_t num_freed;
+    atomic_size_t num_calls;
+
+} Counts;
+
+/*----------------------------------------------------------------------------*/
+
+static void count_free_items(void** items, size_t n, void* arg) {
+
+    Counts* counts = arg;
+
+    for(size_t i = 0; i < n; ++i) {
+        assert(0 != items[i]);
+    }
+
+    atomic_fetch_add(&counts->num_freed, n);
+    atomic_fetch_add(&counts->num_calls, 1);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_reclaimer_create() {
+
+    Counts counts = {0};
+
+    assert(0 == reclaimer_create(0, 1, count_free_items, &counts));
+    assert(0 == reclaimer_create(1, 0, count_free_items, &counts));
+    assert(0 == reclaimer_create(1, 1, 0, &counts));
+
+    Reclaimer* reclaimer = reclaimer_create(4, 2, count_free_items, &counts);
+    assert(reclaimer);
+    assert(collect_func == reclaimer->collect);
+    assert(flush_func == reclaimer->flush);
+    assert(reclaim_func == reclaimer->reclaim);
+    assert(free_func == reclaimer->free);
+
+    assert(0 == reclaimer->free(reclaimer));
+    assert(0 == counts.num_calls);
+
+    assert(0 == free_func(0));
+
+    fprintf(stdout, "reclaimer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_collect_reclaim() {
+
+    int a[20];
+    Counts counts = {0};
+
+    Reclaimer* reclaimer = reclaimer_create(4, 2, count_free_items, &counts);
+
+    assert(! reclaimer->collect(reclaimer, 0));
+    assert(0 == reclaimer->reclaim(reclaimer));
+
+    for(size_t i = 0; i < 3; ++i) {
+        assert(reclaimer->collect(reclaimer, a + i));
+    }
+
+    /* Batch not full yet */
+    assert(0 == reclaimer->reclaim(reclaimer));
+
+    assert(reclaimer->collect(reclaimer, a + 3));
+    assert(0 == counts.num_freed);
+    assert(4 == reclaimer->reclaim(reclaimer));
+    assert(4 == counts.num_freed);
+    assert(1 == counts.num_calls);
+
+    assert(reclaimer->collect(reclaimer, a + 4));
+    assert(reclaimer->flush(reclaimer));
+    assert(1 == reclaimer->reclaim(reclaimer));
+
+    /* Without reclaim, batches run out and are freed right away */
+    for(size_t i = 0; i < 12; ++i) {
+        assert(reclaimer->collect(reclaimer, a + i));
+    }
+
+    assert(9 == counts.num_freed);
+
+    assert(8 == reclaimer->reclaim(reclaimer));
+    assert(17 == counts.num_freed);
+
+    assert(reclaimer->collect(reclaimer, a));
+    assert(0 == reclaimer->free(reclaimer));
+    assert(18 == counts.num_freed);
+
+    /* A single batch awaits reclaim as well */
+    counts = (Counts) {0};
+    reclaimer = reclaimer_create(4, 1, count_free_items, &counts);
+
+    for(size_t i = 0; i < 4; ++i) {
+        assert(reclaimer->collect(reclaimer, a + i));
+    }
+
+    assert(0 == counts.num_freed);
+    assert(4 == reclaimer->reclaim(reclaimer));
+    assert(0 == reclaimer->free(reclaimer));
+
+    fprintf(stdout, "collect()/reclaim() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_ringbuffer_reclaim() {
+
+    int a[20];
+    Counts counts = {0};
+
+    Reclaimer* reclaimer = reclaimer_create(8, 3, count_free_items, &counts);
+    Ringbuffer* buffer =
+        ringbuffer_create(4, reclaimer_free_item, reclaimer);
+
+    for(size_t i = 0; i < 20; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    /* 16 elements have been overwritten, nothing freed on add */
+    assert(0 == counts.num_freed);
+    assert(16 == reclaimer->reclaim(reclaimer));
+    assert(2 == counts.num_calls);
+
+    assert(a + 16 == buffer->pop(buffer));
+
+    assert(0 == buffer->free(buffer));
+    assert(16 == counts.num_freed);
+    assert(0 == reclaimer->free(reclaimer));
+    assert(19 == counts.num_freed);
+
+    fprintf(stdout, "ringbuffer reclaim OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const uintptr_t NUM_ITEMS = 1000 * 1000;
+
+typedef struct {
+
+    Reclaimer* reclaimer;
+    atomic_bool done;
+
+} ReclaimArg;
+
+/*----------------------------------------------------------------------------*/
+
+static void* reclaim_thread(void* arg) {
+
+    ReclaimArg* reclaim_arg = arg;
+
+    while(! atomic_load(&reclaim_arg->done)) {
+
+        if(0 == reclaim_arg->reclaimer->reclaim(reclaim_arg->reclaimer)) {
+            sched_yield();
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_reclaim() {
+
+    Counts counts = {0};
+
+    ReclaimArg arg = {
+        .reclaimer = reclaimer_create(64, 4, count_free_items, &counts),
+    };
+
+    atomic_init(&arg.done, false);
+
+    pthread_t thread;
+    assert(0 == pthread_create(&thread, 0, reclaim_thread, &arg));
+
+    for(uintptr_t i = 1; i <= NUM_ITEMS; ++i) {
+        assert(arg.reclaimer->collect(arg.reclaimer, (void*) i));
+    }
+
+    atomic_store(&arg.done, true);
+    assert(0 == pthread_join(thread, 0));
+
+    assert(0 == arg.reclaimer->free(arg.reclaimer));
+    assert(NUM_ITEMS == counts.num_freed);
+
+    fprintf(stdout, "concurrent reclaim OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+
+    test_reclaimer_create();
+    test_collect_reclaim();
+    test_ringbuffer_reclaim();
+    test_concurrent_reclaim();
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -33,6 +33,7 @@
  */
 /*----------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE
 
 #include "test_helper.h"
 #include "../src/ringbuffer.c"
@@ -104,6 +105,61 @@ void test_free() {
 
 }
 
+void test_ringbuffer_create_with_policy() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == ringbuffer_create_with_policy(0, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == ringbuffer_create_with_policy(1, RINGBUFFER_BLOCK, 0, 0));
+
+    buffer = ringbuffer_create_with_policy(1, RINGBUFFER_OVERWRITE, 0, 0);
+    assert(add_func == buffer->add);
+    assert(add_n_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    buffer = ringbuffer_create_with_policy(1, RINGBUFFER_REJECT, 0, 0);
+    assert(add_reject_func == buffer->add);
+    assert(add_n_reject_func == buffer->add_n);
+    assert(add_wait_reject_func == buffer->add_wait);
+    buffer = buffer->free(buffer);
+
+    test_reject_policy(ringbuffer_create_with_policy);
+
+    fprintf(stdout, "ringbuffer_create_with_policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_overwrite_stats() {
+
+#if defined(RINGBUFFER_STATS)
+
+    int a[10];
+    RingbufferStats stats;
+
+    Ringbuffer* buffer = ringbuffer_create(3, 0, 0);
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(buffer->resize(buffer, 2));
+
+    assert(buffer->stats(buffer, &stats));
+    assert(10 == stats.adds);
+    assert(8 == stats.overwrites);
+    assert(2 == stats.num_items);
+    assert(3 == stats.high_watermark);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "overwrite stats OK\n");
+
+#endif
+
+}
+
 /*----------------------------------------------------------------------------*/
 int main(int argc, char** argv) {
 
@@ -111,8 +167,16 @@ int main(int argc, char** argv) {
     test_capacity();
     test_add();
     test_pop();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_resize();
     test_basic_ringbuffer_create();
     test_free();
+    test_ringbuffer_create_with_policy();
+    test_overwrite_stats();
 
 }
 
@@ -0,0 +1,691 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "test_helper.h"
+#include "../src/spsc_ringbuffer.c"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+
+static Ringbuffer* create_waitable(
+        size_t capacity,
+        void (*free_item)(void* item, void* additional_arg),
+        void* free_item_additional_arg) {
+
+    return spsc_ringbuffer_create_with_policy(capacity,
+            RINGBUFFER_REJECT | RINGBUFFER_WAITABLE,
+            free_item, free_item_additional_arg);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_spsc_ringbuffer_create() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == spsc_ringbuffer_create(0, 0, 0));
+
+    buffer = spsc_ringbuffer_create(1, 0, 0);
+    assert(buffer);
+    assert(capacity_func == buffer->capacity);
+    assert(add_func == buffer->add);
+    assert(pop_func == buffer->pop);
+    assert(free_func == buffer->free);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "spsc_ringbuffer_create OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_spsc_add_pop() {
+
+    int a[20];
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(13, 0, 0);
+
+    assert(! buffer->add(buffer, 0));
+    assert(0 == buffer->pop(buffer));
+
+    for(size_t round = 0; round < 5; ++round) {
+
+        for(size_t i = 0; i < 13; ++i) {
+            assert(buffer->add(buffer, a + i));
+        }
+
+        /* Full - nothing is overwritten */
+        assert(! buffer->add(buffer, a + 13));
+
+        for(size_t i = 0; i < 13; ++i) {
+            assert(a + i == buffer->pop(buffer));
+        }
+
+        assert(0 == buffer->pop(buffer));
+
+    }
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "spsc add()/pop() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_spsc_add_n_pop_n() {
+
+    int a[40];
+    void* items[40];
+    void* out[40];
+
+    for(size_t i = 0; i < 40; ++i) {
+        items[i] = a + i;
+    }
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(13, 0, 0);
+
+    for(size_t round = 0; round < 5; ++round) {
+
+        /* Only as many elements as fit are added */
+        assert(13 == buffer->add_n(buffer, items, 40));
+        assert(0 == buffer->add_n(buffer, items, 40));
+        assert(3 == buffer->pop_n(buffer, out, 3));
+        assert(3 == buffer->add_n(buffer, items + 30, 10));
+        assert(13 == buffer->pop_n(buffer, out, 40));
+
+        for(size_t i = 0; i < 10; ++i) {
+            assert(items[3 + i] == out[i]);
+        }
+
+        for(size_t i = 0; i < 3; ++i) {
+            assert(items[30 + i] == out[10 + i]);
+        }
+
+    }
+
+    /* Stops at the first 0 */
+    items[2] = 0;
+    assert(2 == buffer->add_n(buffer, items, 10));
+    assert(2 == buffer->pop_n(buffer, out, 10));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "spsc add_n()/pop_n() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_spsc_resize() {
+
+    int a[20];
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(3, 0, 0);
+
+    assert(! buffer->resize(buffer, 0));
+
+    for(size_t i = 0; i < 3; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(! buffer->add(buffer, a + 3));
+
+    /* Still fits into the slots of the current segment */
+    assert(buffer->resize(buffer, 4));
+    assert(4 == buffer->capacity(buffer));
+    assert(buffer->add(buffer, a + 3));
+    assert(! buffer->add(buffer, a + 4));
+
+    /* Requires a new segment, twice without adding in between */
+    assert(buffer->resize(buffer, 6));
+    assert(buffer->resize(buffer, 10));
+    assert(10 == buffer->capacity(buffer));
+
+    for(size_t i = 4; i < 10; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(! buffer->add(buffer, a + 10));
+
+    /* Shrinking keeps all elements */
+    assert(buffer->resize(buffer, 2));
+    assert(2 == buffer->capacity(buffer));
+    assert(! buffer->add(buffer, a + 10));
+
+    for(size_t i = 0; i < 8; ++i) {
+        assert(a + i == buffer->pop(buffer));
+    }
+
+    assert(! buffer->add(buffer, a + 10));
+    assert(a + 8 == buffer->pop(buffer));
+    assert(buffer->add(buffer, a + 10));
+    assert(! buffer->add(buffer, a + 11));
+
+    assert(a + 9 == buffer->pop(buffer));
+    assert(a + 10 == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "spsc resize() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void count_free(void* item, void* count) {
+
+    size_t* c = (size_t*) count;
+    *c = *c + 1;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_free() {
+
+    int a = 1;
+    size_t count = 0;
+
+    assert(0 == free_func(0));
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(21, count_free, &count);
+
+    for(size_t i = 0; i < 30; ++i) {
+        buffer->add(buffer, &a);
+    }
+
+    assert(&a == buffer->pop(buffer));
+    assert(0 == buffer->free(buffer));
+    assert(20 == count);
+
+    fprintf(stdout, "free() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static const uintptr_t NUM_TRANSFERS = 1000 * 1000;
+
+/*----------------------------------------------------------------------------*/
+
+static void* producer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+
+    for(uintptr_t i = 1; i <= NUM_TRANSFERS; ++i) {
+
+        while(! buffer->add(buffer, (void*) i)) {
+            sched_yield();
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_transfer() {
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(100, 0, 0);
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(&producer_thread, 0, producer, buffer));
+
+    uintptr_t expected = 1;
+
+    while(expected <= NUM_TRANSFERS) {
+
+        void* item = buffer->pop(buffer);
+
+        if(0 == item) {
+            sched_yield();
+            continue;
+        }
+
+        assert(expected == (uintptr_t) item);
+        ++expected;
+
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent transfer OK\n");
+
+}
+
+static double seconds_since(struct timespec* start) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + 1e-9 * (now.tv_nsec - start->tv_nsec);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* resizing_producer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+
+    size_t capacity = 1;
+
+    for(uintptr_t i = 1; i <= NUM_TRANSFERS; ++i) {
+
+        if(0 == i % 1000) {
+            capacity = (capacity >= 512) ? 1 : 2 * capacity + 1;
+            assert(buffer->resize(buffer, capacity));
+        }
+
+        while(! buffer->add(buffer, (void*) i)) {
+            sched_yield();
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_resize() {
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(1, 0, 0);
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(
+                &producer_thread, 0, resizing_producer, buffer));
+
+    uintptr_t expected = 1;
+
+    while(expected <= NUM_TRANSFERS) {
+
+        void* item = buffer->pop(buffer);
+
+        if(0 == item) {
+            sched_yield();
+            continue;
+        }
+
+        assert(expected == (uintptr_t) item);
+        ++expected;
+
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent resize OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_wait_timeout() {
+
+    int a = 1;
+
+    Ringbuffer* buffer = create_waitable(1, 0, 0);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    assert(0 == buffer->pop_wait(buffer, 20 * 1000));
+    assert(0.02 <= seconds_since(&start));
+
+    assert(buffer->add(buffer, &a));
+    assert(! buffer->add_wait(buffer, 0, -1));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    assert(! buffer->add_wait(buffer, &a, 20 * 1000));
+    assert(0.02 <= seconds_since(&start));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "wait timeout OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* blocking_producer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+
+    for(uintptr_t i = 1; i <= NUM_TRANSFERS; ++i) {
+        assert(buffer->add_wait(buffer, (void*) i, -1));
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_concurrent_blocking_transfer() {
+
+    Ringbuffer* buffer = create_waitable(4, 0, 0);
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(
+                &producer_thread, 0, blocking_producer, buffer));
+
+    for(uintptr_t expected = 1; expected <= NUM_TRANSFERS; ++expected) {
+        assert(expected == (uintptr_t) buffer->pop_wait(buffer, -1));
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent blocking transfer OK\n");
+
+}
+
+void test_spsc_ringbuffer_create_with_policy() {
+
+    Ringbuffer* buffer = 0;
+
+    assert(0 == spsc_ringbuffer_create_with_policy(
+                0, RINGBUFFER_REJECT, 0, 0));
+    assert(0 == spsc_ringbuffer_create_with_policy(
+                1, RINGBUFFER_OVERWRITE, 0, 0));
+    assert(0 == spsc_ringbuffer_create_with_policy(
+                1, RINGBUFFER_OVERWRITE | RINGBUFFER_WAITABLE, 0, 0));
+
+    buffer = spsc_ringbuffer_create_with_policy(1, RINGBUFFER_REJECT, 0, 0);
+    assert(add_func == buffer->add);
+    assert(add_n_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    buffer = spsc_ringbuffer_create_with_policy(1, RINGBUFFER_BLOCK, 0, 0);
+    assert(add_block_func == buffer->add);
+    assert(add_n_block_func == buffer->add_n);
+    buffer = buffer->free(buffer);
+
+    test_reject_policy(spsc_ringbuffer_create_with_policy);
+
+    fprintf(stdout, "spsc_ringbuffer_create_with_policy OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Only waitable ringbuffers may check for waiting threads on add and pop.
+ * Fakes a waiting thread and checks whether it would be woken up.
+ */
+void test_notify_only_if_waitable() {
+
+    int a = 1;
+
+    Ringbuffer* buffer = spsc_ringbuffer_create(2, 0, 0);
+    InternalRingbuffer* internal = (InternalRingbuffer*) buffer;
+
+    assert(! internal->waitable);
+    assert(-1 == buffer->event_fd(buffer, RINGBUFFER_NOT_EMPTY));
+    assert(-1 == buffer->event_fd(buffer, RINGBUFFER_NOT_FULL));
+
+    atomic_store(&internal->not_empty.num_waiters, 1);
+    atomic_store(&internal->not_full.num_waiters, 1);
+
+    assert(buffer->add(buffer, &a));
+    assert(&a == buffer->pop(buffer));
+    assert(1 == buffer->add_n(buffer, (void*[]){&a}, 1));
+    assert(1 == buffer->pop_n(buffer, (void*[1]){0}, 1));
+
+    assert(0 == atomic_load(&internal->not_empty.sequence));
+    assert(0 == atomic_load(&internal->not_full.sequence));
+
+    atomic_store(&internal->not_empty.num_waiters, 0);
+    atomic_store(&internal->not_full.num_waiters, 0);
+
+    buffer = buffer->free(buffer);
+
+    buffer = create_waitable(2, 0, 0);
+    internal = (InternalRingbuffer*) buffer;
+
+    assert(internal->waitable);
+
+    atomic_store(&internal->not_empty.num_waiters, 1);
+    atomic_store(&internal->not_full.num_waiters, 1);
+
+    assert(buffer->add(buffer, &a));
+    assert(1 == atomic_load(&internal->not_empty.sequence));
+    assert(&a == buffer->pop(buffer));
+    assert(1 == atomic_load(&internal->not_full.sequence));
+
+    atomic_store(&internal->not_empty.num_waiters, 0);
+    atomic_store(&internal->not_full.num_waiters, 0);
+
+    buffer = buffer->free(buffer);
+
+    buffer = spsc_ringbuffer_create_with_policy(2, RINGBUFFER_BLOCK, 0, 0);
+    assert(((InternalRingbuffer*) buffer)->waitable);
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "notify only if waitable OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* batch_consumer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+
+    void* out[3];
+    uintptr_t expected = 1;
+
+    while(expected <= 1000) {
+
+        size_t num_popped = buffer->pop_n(buffer, out, 3);
+
+        if(0 == num_popped) {
+            sched_yield();
+            continue;
+        }
+
+        for(size_t i = 0; i < num_popped; ++i) {
+            assert(expected++ == (uintptr_t) out[i]);
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_block_policy() {
+
+    void* items[10];
+
+    Ringbuffer* buffer =
+        spsc_ringbuffer_create_with_policy(4, RINGBUFFER_BLOCK, 0, 0);
+
+    pthread_t consumer_thread;
+    assert(0 == pthread_create(&consumer_thread, 0, batch_consumer, buffer));
+
+    for(uintptr_t i = 1; i <= 500; ++i) {
+        assert(buffer->add(buffer, (void*) i));
+    }
+
+    for(uintptr_t i = 501; i <= 1000; i += 10) {
+
+        for(uintptr_t j = 0; j < 10; ++j) {
+            items[j] = (void*) (i + j);
+        }
+
+        assert(10 == buffer->add_n(buffer, items, 10));
+
+    }
+
+    assert(0 == pthread_join(consumer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "RINGBUFFER_BLOCK OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void wait_readable(int fd) {
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    assert(1 == poll(&pfd, 1, -1));
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void* polling_producer(void* arg) {
+
+    Ringbuffer* buffer = arg;
+    int not_full = buffer->event_fd(buffer, RINGBUFFER_NOT_FULL);
+
+    for(uintptr_t i = 1; i <= NUM_TRANSFERS; ++i) {
+
+        while(! buffer->add(buffer, (void*) i)) {
+            wait_readable(not_full);
+        }
+
+    }
+
+    return 0;
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Both sides only ever sleep in poll, thus a lost signal would hang.
+ */
+void test_concurrent_event_fd_transfer() {
+
+    Ringbuffer* buffer = create_waitable(100, 0, 0);
+
+    int not_empty = buffer->event_fd(buffer, RINGBUFFER_NOT_EMPTY);
+    assert(0 <= buffer->event_fd(buffer, RINGBUFFER_NOT_FULL));
+
+    pthread_t producer_thread;
+    assert(0 == pthread_create(
+                &producer_thread, 0, polling_producer, buffer));
+
+    uintptr_t expected = 1;
+
+    while(expected <= NUM_TRANSFERS) {
+
+        void* item = buffer->pop(buffer);
+
+        if(0 == item) {
+            wait_readable(not_empty);
+            continue;
+        }
+
+        assert(expected == (uintptr_t) item);
+        ++expected;
+
+    }
+
+    assert(0 == pthread_join(producer_thread, 0));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "concurrent transfer via event_fd OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    create = spsc_ringbuffer_create;
+
+    test_ringbuffer_create();
+    test_capacity();
+    test_add_n_pop_n();
+    test_pop_wait_add_wait();
+    test_stats();
+    test_latency();
+    test_event_fd();
+    test_spsc_ringbuffer_create();
+    test_spsc_add_pop();
+    test_spsc_add_n_pop_n();
+    test_spsc_resize();
+    test_free();
+    test_spsc_ringbuffer_create_with_policy();
+    test_notify_only_if_waitable();
+    test_block_policy();
+    test_concurrent_transfer();
+    test_concurrent_resize();
+    test_wait_timeout();
+    test_concurrent_blocking_transfer();
+    test_concurrent_event_fd_transfer();
+
+    create = create_waitable;
+
+    test_pop_wait_add_wait();
+    test_event_fd();
+
+}
+
+/*----------------------------------------------------------------------------*/
@@ -33,9 +33,15 @@
  */
 /*----------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE
+
 #include "test_helper.h"
+#include "../include/ringbuffer_latency.h"
 #include <stdio.h>
 #include <assert.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
 
 /*----------------------------------------------------------------------------*/
 
@@ -181,3 +187,361 @@ void test_pop() {
 
 }
 
+/*----------------------------------------------------------------------------*/
+
+void test_add_n_pop_n() {
+
+    int a[20];
+    void* items[20];
+    void* out[20];
+
+    for(size_t i = 0; i < 20; ++i) {
+        items[i] = a + i;
+    }
+
+    Ringbuffer* buffer = create(20, free_item, free_item_additional_arg);
+
+    assert(0 == buffer->pop_n(buffer, out, 20));
+    assert(0 == buffer->add_n(buffer, items, 0));
+
+    assert(10 == buffer->add_n(buffer, items, 10));
+    assert(4 == buffer->pop_n(buffer, out, 4));
+
+    for(size_t i = 0; i < 4; ++i) {
+        assert(items[i] == out[i]);
+    }
+
+    assert(5 == buffer->add_n(buffer, items + 10, 5));
+    assert(&a[4] == buffer->pop(buffer));
+    assert(buffer->add(buffer, items + 15));
+
+    assert(11 == buffer->pop_n(buffer, out, 20));
+
+    for(size_t i = 0; i < 10; ++i) {
+        assert(items[5 + i] == out[i]);
+    }
+
+    assert(items + 15 == out[10]);
+    assert(0 == buffer->pop_n(buffer, out, 20));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "add_n()/pop_n() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_pop_wait_add_wait() {
+
+    int a = 1;
+
+    Ringbuffer* buffer = create(2, free_item, free_item_additional_arg);
+
+    assert(0 == buffer->pop_wait(buffer, 0));
+    assert(0 == buffer->pop_wait(buffer, 1000));
+
+    assert(buffer->add_wait(buffer, &a, 0));
+    assert(&a == buffer->pop_wait(buffer, 0));
+
+    assert(buffer->add_wait(buffer, &a, -1));
+    assert(&a == buffer->pop_wait(buffer, -1));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "pop_wait()/add_wait() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_resize() {
+
+    int a[8];
+
+    Ringbuffer* buffer = create(4, free_item, free_item_additional_arg);
+
+    assert(! buffer->resize(0, 8));
+    assert(! buffer->resize(buffer, 0));
+
+    for(size_t i = 0; i < 3; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(&a[0] == buffer->pop(buffer));
+    assert(buffer->add(buffer, a + 3));
+    assert(buffer->add(buffer, a + 4));
+
+    /* Grow while the elements wrap around */
+    assert(buffer->resize(buffer, 8));
+    assert(8 == buffer->capacity(buffer));
+
+    for(size_t i = 5; i < 8; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    for(size_t i = 1; i < 8; ++i) {
+        assert(a + i == buffer->pop(buffer));
+    }
+
+    assert(0 == buffer->pop(buffer));
+
+    /* Shrink drops the oldest elements */
+    for(size_t i = 0; i < 8; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(buffer->resize(buffer, 2));
+    assert(2 == buffer->capacity(buffer));
+    assert(&a[6] == buffer->pop(buffer));
+    assert(&a[7] == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+
+    assert(buffer->add(buffer, a + 0));
+    assert(buffer->add(buffer, a + 1));
+    assert(&a[0] == buffer->pop(buffer));
+    assert(&a[1] == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "resize() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_stats() {
+
+    RingbufferStats stats;
+
+    Ringbuffer* buffer = create(4, free_item, free_item_additional_arg);
+
+    assert(! buffer->stats(0, &stats));
+    assert(! buffer->stats(buffer, 0));
+
+#if defined(RINGBUFFER_STATS)
+
+    int a[4];
+    void* out[4];
+
+    assert(buffer->stats(buffer, &stats));
+    assert(0 == stats.adds);
+    assert(0 == stats.high_watermark);
+
+    assert(0 == buffer->pop(buffer));
+
+    for(size_t i = 0; i < 3; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(a == buffer->pop(buffer));
+    assert(buffer->add(buffer, a + 3));
+    assert(2 == buffer->pop_n(buffer, out, 2));
+
+    assert(buffer->stats(buffer, &stats));
+    assert(4 == stats.adds);
+    assert(3 == stats.pops);
+    assert(1 == stats.empty_pops);
+    assert(0 == stats.overwrites);
+    assert(1 == stats.num_items);
+    assert(3 == stats.high_watermark);
+
+#else
+
+    assert(! buffer->stats(buffer, &stats));
+
+#endif
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "stats() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_latency() {
+
+    RingbufferLatency latency;
+
+    Ringbuffer* buffer = create(4, free_item, free_item_additional_arg);
+
+    assert(! buffer->latency(0, &latency, false));
+    assert(! buffer->latency(buffer, 0, false));
+
+#if defined(RINGBUFFER_LATENCY)
+
+    int a[4];
+    void* out[4];
+
+    assert(buffer->latency(buffer, &latency, false));
+    assert(0 == latency.num_samples);
+    assert(0 == ringbuffer_latency_percentile(&latency, 50));
+
+    assert(buffer->add(buffer, a));
+    assert(buffer->add(buffer, a + 1));
+
+    struct timespec one_msec = {.tv_sec = 0, .tv_nsec = 1000 * 1000};
+    nanosleep(&one_msec, 0);
+
+    assert(a == buffer->pop(buffer));
+    assert(a + 1 == buffer->pop(buffer));
+
+    assert(buffer->latency(buffer, &latency, false));
+    assert(2 == latency.num_samples);
+    assert(1000 * 1000 <= ringbuffer_latency_percentile(&latency, 50));
+
+    /* Adding alone does not record anything */
+    for(size_t i = 0; i < 3; ++i) {
+        assert(buffer->add(buffer, a + i));
+    }
+
+    assert(buffer->latency(buffer, &latency, true));
+    assert(2 == latency.num_samples);
+
+    assert(buffer->latency(buffer, &latency, false));
+    assert(0 == latency.num_samples);
+
+    assert(3 == buffer->pop_n(buffer, out, 4));
+
+    assert(buffer->latency(buffer, &latency, true));
+    assert(3 == latency.num_samples);
+
+#else
+
+    assert(! buffer->latency(buffer, &latency, false));
+
+#endif
+
+    buffer = buffer->free(buffer);
+
+    /* Buckets are exact below RINGBUFFER_LATENCY_SUB_BUCKETS, then
+     * each power of two is split into RINGBUFFER_LATENCY_SUB_BUCKETS */
+    for(uint64_t nsecs = 0; nsecs < 100 * 1000; ++nsecs) {
+
+        size_t bucket = ringbuffer_latency_bucket(nsecs);
+
+        assert(bucket < RINGBUFFER_LATENCY_BUCKETS);
+        assert(ringbuffer_latency_bucket_start(bucket) <= nsecs);
+        assert(ringbuffer_latency_bucket_start(bucket + 1) > nsecs);
+
+    }
+
+    assert(RINGBUFFER_LATENCY_BUCKETS - 1 ==
+            ringbuffer_latency_bucket(UINT64_MAX));
+
+    fprintf(stdout, "latency() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+static bool is_readable(int fd) {
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    return 1 == poll(&pfd, 1, 0);
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_event_fd() {
+
+    int a[3];
+
+    Ringbuffer* buffer = create(2, free_item, free_item_additional_arg);
+
+    assert(-1 == buffer->event_fd(0, RINGBUFFER_NOT_EMPTY));
+
+    int not_empty = buffer->event_fd(buffer, RINGBUFFER_NOT_EMPTY);
+
+    if(0 > not_empty) {
+
+        assert(-1 == buffer->event_fd(buffer, RINGBUFFER_NOT_FULL));
+        buffer = buffer->free(buffer);
+
+        fprintf(stdout, "event_fd() (not supported) OK\n");
+        return;
+
+    }
+
+    int not_full = buffer->event_fd(buffer, RINGBUFFER_NOT_FULL);
+
+    assert(0 <= not_full);
+    assert(not_full != not_empty);
+    assert(not_empty == buffer->event_fd(buffer, RINGBUFFER_NOT_EMPTY));
+
+    /* Signalled on creation, pop rearms it */
+    assert(is_readable(not_empty));
+    assert(0 == buffer->pop(buffer));
+    assert(! is_readable(not_empty));
+
+    assert(buffer->add(buffer, a));
+    assert(is_readable(not_empty));
+    assert(buffer->add(buffer, a + 1));
+
+    /* Failing add rearms not_full */
+    assert(is_readable(not_full));
+    assert(! buffer->add(buffer, a + 2));
+    assert(! is_readable(not_full));
+
+    assert(a == buffer->pop(buffer));
+    assert(is_readable(not_full));
+    assert(is_readable(not_empty));
+
+    assert(a + 1 == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+    assert(! is_readable(not_empty));
+
+    /* A burst of adds signals once */
+    assert(buffer->add(buffer, a));
+    assert(buffer->add(buffer, a + 1));
+
+    eventfd_t value = 0;
+    assert(0 == eventfd_read(not_empty, &value));
+    assert(1 == value);
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "event_fd() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_reject_policy(Ringbuffer* (*create_with_policy)(
+            size_t, RingbufferPolicy, void (*)(void*, void*), void*)) {
+
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    void* items[] = {&a, &b, &c};
+
+    Ringbuffer* buffer = create_with_policy(2, RINGBUFFER_REJECT,
+            free_item, free_item_additional_arg);
+
+    assert(buffer->add(buffer, &a));
+    assert(buffer->add(buffer, &b));
+    assert(! buffer->add(buffer, &c));
+    assert(! buffer->add_wait(buffer, &c, 0));
+    assert(&a == buffer->pop(buffer));
+    assert(buffer->add(buffer, &c));
+    assert(&b == buffer->pop(buffer));
+    assert(&c == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+
+    assert(2 == buffer->add_n(buffer, items, 3));
+    assert(0 == buffer->add_n(buffer, items, 3));
+    assert(&a == buffer->pop(buffer));
+    assert(1 == buffer->add_n(buffer, items + 2, 1));
+    assert(&b == buffer->pop(buffer));
+    assert(&c == buffer->pop(buffer));
+    assert(0 == buffer->pop(buffer));
+
+    buffer = buffer->free(buffer);
+
+    fprintf(stdout, "RINGBUFFER_REJECT OK\n");
+
+}
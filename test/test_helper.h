@@ -49,6 +49,14 @@ void test_ringbuffer_create();
 void test_capacity();
 void test_add();
 void test_pop();
+void test_add_n_pop_n();
+void test_pop_wait_add_wait();
+void test_resize();
+void test_stats();
+void test_latency();
+void test_event_fd();
+void test_reject_policy(Ringbuffer* (*create_with_policy)(
+            size_t, RingbufferPolicy, void (*)(void*, void*), void*));
 
 /*----------------------------------------------------------------------------*/
 #endif
@@ -0,0 +1,188 @@
+/*
+ * (C) 2018 Michael J. Beer
+ * All rights reserved.
+ *
+ * Redistribution  and use in source and binary forms, with or with‐
+ * out modification, are permitted provided that the following  con‐
+ * ditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above  copy‐
+ * right  notice,  this  list  of  conditions and the following dis‐
+ * claimer in the documentation and/or other materials provided with
+ * the distribution.
+ *
+ * 3.  Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote  products  derived
+ * from this software without specific prior written permission.
+ *
+ * THIS  SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBU‐
+ * TORS "AS IS" AND ANY EXPRESS OR  IMPLIED  WARRANTIES,  INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT
+ * SHALL  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DI‐
+ * RECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR  CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS IN‐
+ * TERRUPTION)  HOWEVER  CAUSED  AND  ON  ANY  THEORY  OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  NEGLI‐
+ * GENCE  OR  OTHERWISE)  ARISING  IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*----------------------------------------------------------------------------*/
+
+
+#include "../include/typed_ringbuffer.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+
+    uint32_t id;
+    float value;
+
+} Sample;
+
+/*----------------------------------------------------------------------------*/
+
+RINGBUFFER_DEFINE(U64Ringbuffer1, uint64_t, 1)
+RINGBUFFER_DEFINE(U64Ringbuffer2, uint64_t, 2)
+RINGBUFFER_DEFINE(U64Ringbuffer13, uint64_t, 13)
+RINGBUFFER_DEFINE(SampleRingbuffer, Sample, 16)
+
+/*----------------------------------------------------------------------------*/
+
+void test_capacity() {
+
+    U64Ringbuffer1 b1;
+    U64Ringbuffer1_init(&b1);
+    assert(1 == U64Ringbuffer1_capacity(&b1));
+
+    U64Ringbuffer13 b13;
+    U64Ringbuffer13_init(&b13);
+    assert(13 == U64Ringbuffer13_capacity(&b13));
+    assert(0 == U64Ringbuffer13_num_items(&b13));
+
+    fprintf(stdout, "capacity() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_add_pop() {
+
+    uint64_t item = 0;
+
+    U64Ringbuffer1 b1;
+    U64Ringbuffer1_init(&b1);
+
+    assert(! U64Ringbuffer1_pop(&b1, &item));
+    assert(U64Ringbuffer1_add(&b1, 1));
+    assert(U64Ringbuffer1_pop(&b1, &item));
+    assert(1 == item);
+    assert(! U64Ringbuffer1_pop(&b1, &item));
+
+    assert(U64Ringbuffer1_add(&b1, 1));
+    assert(U64Ringbuffer1_add(&b1, 2));
+    assert(U64Ringbuffer1_pop(&b1, &item));
+    assert(2 == item);
+    assert(! U64Ringbuffer1_pop(&b1, &item));
+
+    U64Ringbuffer2 b2;
+    U64Ringbuffer2_init(&b2);
+
+    assert(U64Ringbuffer2_add(&b2, 1));
+    assert(U64Ringbuffer2_add(&b2, 2));
+    assert(U64Ringbuffer2_add(&b2, 3));
+    assert(2 == U64Ringbuffer2_num_items(&b2));
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(2 == item);
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(3 == item);
+    assert(! U64Ringbuffer2_pop(&b2, &item));
+
+    assert(U64Ringbuffer2_add(&b2, 1));
+    assert(U64Ringbuffer2_add(&b2, 2));
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(1 == item);
+    assert(U64Ringbuffer2_add(&b2, 3));
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(2 == item);
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(3 == item);
+    assert(! U64Ringbuffer2_pop(&b2, &item));
+
+    /* 0 is a valid value */
+    assert(U64Ringbuffer2_add(&b2, 0));
+    assert(U64Ringbuffer2_pop(&b2, &item));
+    assert(0 == item);
+
+    fprintf(stdout, "add()/pop() OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_wrap_around() {
+
+    uint64_t item = 0;
+
+    U64Ringbuffer13 buffer;
+    U64Ringbuffer13_init(&buffer);
+
+    for(uint64_t i = 0; i < 100; ++i) {
+        assert(U64Ringbuffer13_add(&buffer, i));
+    }
+
+    for(uint64_t i = 100 - 13; i < 100; ++i) {
+        assert(U64Ringbuffer13_pop(&buffer, &item));
+        assert(i == item);
+    }
+
+    assert(! U64Ringbuffer13_pop(&buffer, &item));
+
+    fprintf(stdout, "wrap around OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+
+void test_struct_items() {
+
+    Sample sample = {0};
+
+    SampleRingbuffer buffer;
+    SampleRingbuffer_init(&buffer);
+
+    for(uint32_t i = 0; i < 10; ++i) {
+        assert(SampleRingbuffer_add(&buffer, (Sample){.id = i, .value = i}));
+    }
+
+    for(uint32_t i = 0; i < 10; ++i) {
+        assert(SampleRingbuffer_pop(&buffer, &sample));
+        assert(i == sample.id);
+        assert(i == sample.value);
+    }
+
+    assert(! SampleRingbuffer_pop(&buffer, &sample));
+
+    fprintf(stdout, "struct items OK\n");
+
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv) {
+
+    test_capacity();
+    test_add_pop();
+    test_wrap_around();
+    test_struct_items();
+
+}
+
+/*----------------------------------------------------------------------------*/